@@ -31,7 +31,7 @@ khttp::ks_initializer khttp::ksinit_;
 
 khttp::khttp(const std::string &server)
         : url_parser_(server),
-          header_config_({"Windows WSK Client"}) {
+          header_config_({"Windows WSK Client", "*/*"}) {
 
     if (!ksinit_.valid()) {
         KdPrint(("Failed to initialize ksocket\n"));
@@ -46,6 +46,10 @@ khttp::khttp(const std::string &server)
     }
 }
 
+void khttp::set_accept(const std::string &accept) {
+    header_config_.accept = accept;
+}
+
 httpparser::Response khttp::get(const std::string &path) {
     return http_impl("GET", path, "");
 }
@@ -71,7 +75,7 @@ std::string khttp::build_request(
     s += method + " " + path + " HTTP/1.1\r\n";
     s += "Host: " + url_parser_.hostname() + "\r\n";
     s += "User-Agent: " + header_config_.user_agent + "\r\n";
-    s += "Accept: */*\r\n";
+    s += "Accept: " + header_config_.accept + "\r\n";
     s += "Connection: close\r\n";
     s += "Content-Length: " + std::to_string(content.length()) + "\r\n";
     s += "\r\n";
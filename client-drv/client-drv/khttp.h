@@ -12,6 +12,8 @@ class khttp {
 public:
     explicit khttp(const std::string &server);
 
+    void set_accept(const std::string &accept);
+
     httpparser::Response get(const std::string &path);
 
     httpparser::Response post(const std::string &path, const std::string &content);
@@ -35,6 +37,7 @@ private:
 
     struct header_config {
         std::string user_agent;
+        std::string accept;
     };
 
     static ks_initializer ksinit_;
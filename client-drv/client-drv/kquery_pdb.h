@@ -14,6 +14,7 @@
 #include "json.hpp"
 
 #include "khttp.h"
+#include "../../client/qpdb_wire.h"
 
 class kqpdb {
 public:
@@ -69,24 +70,7 @@ public:
     }
 
     std::map<std::string, int64_t> get_symbol(const std::set<std::string> &names) const {
-        if (!valid_) {
-            throw std::runtime_error("invalid file, cannot get pdb info");
-        }
-
-        nlohmann::json j;
-        j["name"] = info_.name;
-        j["guid"] = info_.guid;
-        j["age"] = info_.age;
-        j["query"] = names;
-
-        khttp client(server_);
-        auto res = client.post("/symbol", j.dump());
-        if (res.statusCode != 200) {
-            throw std::runtime_error("request failed");
-        }
-
-        return nlohmann::json::parse(to_string(res.content))
-                .get<std::map<std::string, int64_t>>();
+        return request("/symbol", names).get<std::map<std::string, int64_t>>();
     }
 
     int64_t get_symbol(const std::string &name) const {
@@ -95,23 +79,7 @@ public:
 
     std::map<std::string, std::map<std::string, field_info>>
     get_struct(const std::map<std::string, std::set<std::string>> &names) const {
-        if (!valid_) {
-            throw std::runtime_error("invalid file, cannot get pdb info");
-        }
-
-        nlohmann::json j;
-        j["name"] = info_.name;
-        j["guid"] = info_.guid;
-        j["age"] = info_.age;
-        j["query"] = names;
-
-        khttp client(server_);
-        auto res = client.post("/struct", j.dump());
-        if (res.statusCode != 200) {
-            throw std::runtime_error("request failed");
-        }
-
-        auto result = nlohmann::json::parse(to_string(res.content))
+        auto result = request("/struct", names)
                 .get<std::map<std::string, std::map<std::string, std::map<std::string, int64_t>>>>();
 
         std::map<std::string, std::map<std::string, field_info>> field_info_map;
@@ -137,37 +105,158 @@ public:
 
     std::map<std::string, std::map<std::string, int64_t>>
     get_enum(const std::map<std::string, std::set<std::string>> &names) const {
+        return request("/enum", names)
+                .get<std::map<std::string, std::map<std::string, int64_t>>>();
+    }
+
+    std::map<std::string, int64_t>
+    get_enum(const std::string &name, const std::set<std::string> &keys) const {
+        return get_enum(std::map<std::string, std::set<std::string>>{{name, keys}})
+                .at(name);
+    }
+
+    int64_t get_enum(const std::string &name, const std::string &key) const {
+        return get_enum(name, std::set<std::string>{key}).at(key);
+    }
+
+    // array variants, results are written to the caller's arrays in the order
+    // of the names, the response is the fixed layout binary format which is
+    // read in place (see qpdb_wire.h), names that are not found get -1
+    bool get_symbol(const char *const names[], size_t count, int64_t offsets[]) const {
+        nlohmann::json query = nlohmann::json::array();
+        for (size_t i = 0; i < count; i++) {
+            query.push_back(names[i]);
+        }
+
+        bool success = false;
+        request_wire("/symbol", query, qpdb_wire::symbol, count, [&](const qpdb_wire::view &v) {
+            for (uint32_t i = 0; i < v.count(); i++) {
+                auto record = v.at(i);
+                if (record.name_hash != qpdb_wire::hash(names[i])) {
+                    return;
+                }
+                offsets[i] = record.offset;
+            }
+            success = true;
+        });
+        return success;
+    }
+
+    bool get_struct(const char *name, const char *const fields[], size_t count,
+                    field_info fields_info[]) const {
+        nlohmann::json query;
+        query[name] = nlohmann::json::array();
+        for (size_t i = 0; i < count; i++) {
+            query[name].push_back(fields[i]);
+        }
+
+        bool success = false;
+        request_wire("/struct", query, qpdb_wire::structure, count, [&](const qpdb_wire::view &v) {
+            for (uint32_t i = 0; i < v.count(); i++) {
+                auto record = v.at(i);
+                if (record.name_hash != qpdb_wire::hash(name, fields[i])) {
+                    return;
+                }
+                fields_info[i].offset = record.offset;
+                fields_info[i].bitfield_offset = record.bitfield_offset;
+            }
+            success = true;
+        });
+        return success;
+    }
+
+    bool get_enum(const char *name, const char *const keys[], size_t count, int64_t values[]) const {
+        nlohmann::json query;
+        query[name] = nlohmann::json::array();
+        for (size_t i = 0; i < count; i++) {
+            query[name].push_back(keys[i]);
+        }
+
+        bool success = false;
+        request_wire("/enum", query, qpdb_wire::enumeration, count, [&](const qpdb_wire::view &v) {
+            for (uint32_t i = 0; i < v.count(); i++) {
+                auto record = v.at(i);
+                if (record.name_hash != qpdb_wire::hash(name, keys[i])) {
+                    return;
+                }
+                values[i] = record.offset;
+            }
+            success = true;
+        });
+        return success;
+    }
+
+private:
+    // results are requested as MessagePack, decoding it is much cheaper
+    // than parsing JSON, servers not supporting it still answer with JSON
+    nlohmann::json request(const std::string &path, const nlohmann::json &query) const {
         if (!valid_) {
             throw std::runtime_error("invalid file, cannot get pdb info");
         }
 
-        nlohmann::json j;
-        j["name"] = info_.name;
-        j["guid"] = info_.guid;
-        j["age"] = info_.age;
-        j["query"] = names;
-
         khttp client(server_);
-        auto res = client.post("/enum", j.dump());
+        client.set_accept("application/msgpack");
+        auto res = client.post(path, build_body(query));
         if (res.statusCode != 200) {
             throw std::runtime_error("request failed");
         }
 
-        return nlohmann::json::parse(to_string(res.content))
-                .get<std::map<std::string, std::map<std::string, int64_t>>>();
+        return decode(res);
     }
 
-    std::map<std::string, int64_t>
-    get_enum(const std::string &name, const std::set<std::string> &keys) const {
-        return get_enum(std::map<std::string, std::set<std::string>>{{name, keys}})
-                .at(name);
+    // f is only called with a response of the expected kind and count
+    template<typename F>
+    void request_wire(const std::string &path, const nlohmann::json &query,
+                      qpdb_wire::kind kind, size_t count, F f) const {
+        if (!valid_) {
+            return;
+        }
+
+        khttp client(server_);
+        client.set_accept("application/x-qpdb-wire");
+        auto res = client.post(path, build_body(query));
+        if (res.statusCode != 200 || get_content_type(res) != "application/x-qpdb-wire") {
+            return;
+        }
+
+        qpdb_wire::view v(res.content.data(), res.content.size());
+        if (!v.valid() || v.kind() != kind || v.count() != count) {
+            return;
+        }
+        f(v);
     }
 
-    int64_t get_enum(const std::string &name, const std::string &key) const {
-        return get_enum(name, std::set<std::string>{key}).at(key);
+    std::string build_body(const nlohmann::json &query) const {
+        nlohmann::json j;
+        j["name"] = info_.name;
+        j["guid"] = info_.guid;
+        j["age"] = info_.age;
+        j["query"] = query;
+        return j.dump();
+    }
+
+    static std::string get_content_type(const httpparser::Response &res) {
+        std::string content_type;
+        for (const auto &header: res.headers) {
+            if (header.name == "Content-Type") {
+                content_type = header.value;
+            }
+        }
+        return content_type;
+    }
+
+    static nlohmann::json decode(const httpparser::Response &res) {
+        std::string content_type = get_content_type(res);
+
+        if (content_type == "application/msgpack") {
+            return nlohmann::json::from_msgpack(res.content);
+        }
+        if (content_type == "application/cbor") {
+            return nlohmann::json::from_cbor(res.content);
+        }
+        return nlohmann::json::parse(to_string(res.content));
     }
 
-private:
     class kfile {
     public:
         explicit kfile(const std::string &path)
@@ -0,0 +1,334 @@
+#ifndef QUERY_PDB_CLIENT_QPDB_SHM_H
+#define QUERY_PDB_CLIENT_QPDB_SHM_H
+
+// shared memory interface for callers on the same host (query-pdb --shm-path, linux only).
+// the server creates the ring file on tmpfs, a client maps it and talks to the server
+// through slots, without a socket, http framing or json.
+//
+// +----------------------+
+// | ring_header (64)     |
+// +----------------------+
+// | slot 0 (slot_size)   |  slot_header (64 bytes), then the request, later the response
+// | slot 1               |
+// | ...                  |
+// +----------------------+
+//
+// a slot goes idle -> claimed (by a client) -> submitted (to the server) -> working
+// -> answered -> idle (released by the client). the state words are only changed
+// with atomic operations, nobody takes a lock. a waiting side sleeps on a futex
+// once spinning for a short while did not see the change. a client claims a slot by
+// writing its process id to the owner word, the server takes back the slots of
+// clients that ended without releasing them. process ids are only compared within
+// one pid namespace, a client has to share the namespace of the server (in a
+// container: --pid=host or the pid namespace of the server container), otherwise
+// the ring is not valid() for it.
+//
+// request data: the pdb name '\0', then count names, each one "symbol\0" for
+// qpdb_wire::symbol or "type\0member\0" for qpdb_wire::structure and enumeration.
+// response data (status ok): the wire encoding of client/qpdb_wire.h, one record
+// per requested name in request order, read it with qpdb_wire::view.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#ifdef __linux__
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+#include "qpdb_wire.h"
+
+namespace qpdb_shm {
+
+    const uint32_t magic = 0x4d485351; // "QSHM"
+    const uint16_t version = 3;
+    const uint32_t slot_size = 16384;
+
+    enum state : uint32_t {
+        idle = 0,
+        claimed = 1,
+        submitted = 2,
+        working = 3,
+        answered = 4,
+    };
+
+    enum status : uint16_t {
+        ok = 0,
+        // the request data does not follow the layout above
+        invalid = 1,
+        // no server has the pdb
+        not_found = 2,
+        // rejected like a 503, try again later
+        overloaded = 3,
+        // the response does not fit into the slot, ask for fewer names
+        too_large = 4,
+        failed = 5,
+    };
+
+    struct ring_header {
+        uint32_t magic;
+        uint16_t version;
+        uint16_t reserved;
+        uint32_t slot_count;
+        uint32_t slot_size;
+        // where a client starts looking for a free slot
+        uint32_t next_slot;
+        // bumped for every request, the server sleeps on it
+        uint32_t doorbell;
+        uint32_t server_sleeping;
+        // a client stops waiting once the server process is gone
+        int32_t server_pid;
+        // inode of the pid namespace of the server, 0 if unknown
+        uint64_t pid_namespace;
+        uint8_t padding[24];
+    };
+
+    struct slot_header {
+        uint32_t state;
+        // the client sleeps on state
+        uint32_t client_waiting;
+        uint16_t kind;
+        uint16_t status;
+        uint32_t age;
+        uint32_t count;
+        // bytes of data used by the request, then by the response
+        uint32_t size;
+        char guid[32];
+        // process id of the client holding the slot, 0 if it is free
+        uint32_t owner;
+        uint8_t padding[4];
+    };
+
+    const size_t data_capacity = slot_size - sizeof(slot_header);
+
+    inline size_t ring_size(uint32_t slot_count) {
+        return sizeof(ring_header) + static_cast<size_t>(slot_count) * slot_size;
+    }
+
+    inline slot_header *get_slot(void *ring, uint32_t index) {
+        return reinterpret_cast<slot_header *>(static_cast<char *>(ring) + sizeof(ring_header) +
+                                               static_cast<size_t>(index) * slot_size);
+    }
+
+    inline char *get_data(slot_header *slot) {
+        return reinterpret_cast<char *>(slot) + sizeof(slot_header);
+    }
+
+#ifdef __linux__
+
+    // the ring is shared between processes, the futexes are not private
+    inline void wait(uint32_t *word, uint32_t expected, long timeout_ns) {
+        timespec timeout = {0, timeout_ns};
+        syscall(SYS_futex, word, FUTEX_WAIT, expected, &timeout, nullptr, 0);
+    }
+
+    inline void wake(uint32_t *word) {
+        syscall(SYS_futex, word, FUTEX_WAKE, INT32_MAX, nullptr, nullptr, 0);
+    }
+
+    inline uint32_t load(const uint32_t *word) {
+        return __atomic_load_n(word, __ATOMIC_SEQ_CST);
+    }
+
+    inline void store(uint32_t *word, uint32_t value) {
+        __atomic_store_n(word, value, __ATOMIC_SEQ_CST);
+    }
+
+    inline bool exchange(uint32_t *word, uint32_t expected, uint32_t value) {
+        return __atomic_compare_exchange_n(word, &expected, value, false,
+                                           __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+    }
+
+    // inode of the pid namespace of the calling process, 0 if /proc does not tell
+    inline uint64_t get_pid_namespace() {
+        struct stat st;
+        return stat("/proc/self/ns/pid", &st) == 0 ? static_cast<uint64_t>(st.st_ino) : 0;
+    }
+
+    inline void pause() {
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause();
+#endif
+    }
+
+    // a mapped ring. a client is shared by the threads of a process, every call
+    // works on a slot of its own
+    //
+    // qpdb_shm::client ring("/dev/shm/query-pdb");
+    // qpdb_shm::slot_header *slot = ring.acquire();
+    // ring.begin(slot, qpdb_wire::symbol, "ntdll.pdb", "ABCDEF...", 1);
+    // ring.add(slot, "Name1");
+    // if (ring.call(slot) == qpdb_shm::ok) {
+    //     qpdb_wire::view v(qpdb_shm::get_data(slot), slot->size);
+    // }
+    // ring.release(slot);
+    class client {
+    public:
+        explicit client(const char *path)
+                : ring_(nullptr),
+                  size_(0),
+                  header_(nullptr),
+                  spin_(0) {
+
+            int fd = open(path, O_RDWR | O_CLOEXEC);
+            if (fd == -1) {
+                return;
+            }
+            struct stat st;
+            if (fstat(fd, &st) == 0 && static_cast<size_t>(st.st_size) >= sizeof(ring_header)) {
+                void *ring = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ | PROT_WRITE,
+                                  MAP_SHARED, fd, 0);
+                if (ring != MAP_FAILED) {
+                    ring_ = ring;
+                    size_ = static_cast<size_t>(st.st_size);
+                }
+            }
+            close(fd);
+            if (!ring_) {
+                return;
+            }
+
+            // the owner words and server_pid are process ids of the server's namespace
+            ring_header *header = static_cast<ring_header *>(ring_);
+            uint64_t pid_namespace = get_pid_namespace();
+            if (header->magic == magic && header->version == version &&
+                header->slot_size == slot_size && ring_size(header->slot_count) <= size_ &&
+                (header->pid_namespace == 0 || pid_namespace == 0 || header->pid_namespace == pid_namespace)) {
+                header_ = header;
+            }
+            // spinning only helps while the server runs on another cpu
+            if (sysconf(_SC_NPROCESSORS_ONLN) > 1) {
+                spin_ = 4000;
+            }
+        }
+
+        ~client() {
+            if (ring_) {
+                munmap(ring_, size_);
+            }
+        }
+
+        client(const client &) = delete;
+
+        client &operator=(const client &) = delete;
+
+        bool valid() const {
+            return header_ != nullptr;
+        }
+
+        // claim a free slot, nullptr if all of them are in use
+        slot_header *acquire() {
+            if (!header_) {
+                return nullptr;
+            }
+            uint32_t count = header_->slot_count;
+            uint32_t start = __atomic_fetch_add(&header_->next_slot, 1, __ATOMIC_RELAXED);
+            uint32_t pid = static_cast<uint32_t>(getpid());
+            for (uint32_t i = 0; i < count; i++) {
+                slot_header *slot = get_slot(ring_, (start + i) % count);
+                // the owner word is the claim, a slot of a process that ended before
+                // the state was set is still taken back by the server
+                if (load(&slot->state) == idle && exchange(&slot->owner, 0, pid)) {
+                    store(&slot->state, claimed);
+                    return slot;
+                }
+            }
+            return nullptr;
+        }
+
+        void begin(slot_header *slot, qpdb_wire::kind kind, const char *name, const char *guid, uint32_t age) {
+            slot->kind = kind;
+            slot->status = ok;
+            slot->age = age;
+            slot->count = 0;
+            slot->size = 0;
+            size_t guid_size = strlen(guid);
+            memset(slot->guid, 0, sizeof(slot->guid));
+            memcpy(slot->guid, guid, guid_size < sizeof(slot->guid) ? guid_size : sizeof(slot->guid));
+            append(slot, name);
+        }
+
+        // a symbol, false if the slot is full
+        bool add(slot_header *slot, const char *name) {
+            if (!append(slot, name)) {
+                return false;
+            }
+            slot->count++;
+            return true;
+        }
+
+        // a struct field or an enumerator, false if the slot is full
+        bool add(slot_header *slot, const char *type, const char *member) {
+            uint32_t size = slot->size;
+            if (!append(slot, type) || !append(slot, member)) {
+                slot->size = size;
+                return false;
+            }
+            slot->count++;
+            return true;
+        }
+
+        // hand the request to the server and wait for the answer, returns its status.
+        // the response is in get_data(slot) until the slot is released
+        status call(slot_header *slot) {
+            if (slot->size > data_capacity ||
+                sizeof(qpdb_wire::header) + static_cast<size_t>(slot->count) * sizeof(qpdb_wire::record) >
+                data_capacity) {
+                return too_large;
+            }
+            store(&slot->state, submitted);
+            __atomic_fetch_add(&header_->doorbell, 1, __ATOMIC_SEQ_CST);
+            if (load(&header_->server_sleeping)) {
+                wake(&header_->doorbell);
+            }
+
+            // most answers come from parsed pdb files within a few microseconds
+            for (int i = 0; i < spin_ && load(&slot->state) != answered; i++) {
+                pause();
+            }
+            store(&slot->client_waiting, 1);
+            uint32_t current;
+            while ((current = load(&slot->state)) != answered) {
+                wait(&slot->state, current, 100 * 1000 * 1000);
+                if (load(&slot->state) != answered && kill(header_->server_pid, 0) == -1 && errno == ESRCH) {
+                    store(&slot->client_waiting, 0);
+                    return failed;
+                }
+            }
+            store(&slot->client_waiting, 0);
+            return static_cast<status>(slot->status);
+        }
+
+        void release(slot_header *slot) {
+            store(&slot->state, idle);
+            store(&slot->owner, 0);
+        }
+
+    private:
+        void *ring_;
+        size_t size_;
+        ring_header *header_;
+        int spin_;
+
+        bool append(slot_header *slot, const char *text) {
+            size_t size = strlen(text) + 1;
+            if (data_capacity - slot->size < size) {
+                return false;
+            }
+            memcpy(get_data(slot) + slot->size, text, size);
+            slot->size += static_cast<uint32_t>(size);
+            return true;
+        }
+    };
+
+#endif
+
+}
+
+#endif //QUERY_PDB_CLIENT_QPDB_SHM_H
@@ -0,0 +1,127 @@
+#ifndef QUERY_PDB_CLIENT_QPDB_WIRE_H
+#define QUERY_PDB_CLIENT_QPDB_WIRE_H
+
+// fixed layout binary response, requested with "Accept: application/x-qpdb-wire".
+// the decoder reads the response in place, it neither allocates nor depends on
+// anything but the C headers below, so it can be used in kernel mode as well.
+//
+// +----------------------+
+// | header   (16 bytes)  |
+// +----------------------+
+// | record 0 (24 bytes)  |  one record per requested name, in request order
+// | record 1             |
+// | ...                  |
+// +----------------------+
+//
+// all integers are little endian.
+// /symbol: one record per name, offset is the RVA
+// /struct: the requested fields of the first struct, then those of the second
+//          struct, ... name_hash covers "struct::field"
+// /enum:   like /struct, offset is the enumerator value
+// names that are not found have offset -1
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+namespace qpdb_wire {
+
+    const uint32_t magic = 0x42445051; // "QPDB"
+    const uint16_t version = 1;
+
+    enum kind : uint16_t {
+        symbol = 1,
+        structure = 2,
+        enumeration = 3,
+    };
+
+    struct header {
+        uint32_t magic;
+        uint16_t version;
+        uint16_t kind;
+        uint32_t count;
+        uint32_t reserved;
+    };
+
+    struct record {
+        uint64_t name_hash;
+        int64_t offset;
+        int64_t bitfield_offset;
+    };
+
+    // 64 bit FNV-1a
+    inline uint64_t hash_append(uint64_t h, const char *s) {
+        for (; *s; s++) {
+            h ^= static_cast<unsigned char>(*s);
+            h *= 0x100000001b3ull;
+        }
+        return h;
+    }
+
+    inline uint64_t hash(const char *name) {
+        return hash_append(0xcbf29ce484222325ull, name);
+    }
+
+    inline uint64_t hash(const char *type, const char *member) {
+        return hash_append(hash_append(hash(type), "::"), member);
+    }
+
+    class view {
+    public:
+        view(const void *data, size_t size)
+                : data_(static_cast<const unsigned char *>(data)),
+                  header_(),
+                  valid_(false) {
+
+            if (!data_ || size < sizeof(header)) {
+                return;
+            }
+            memcpy(&header_, data_, sizeof(header));
+            if (header_.magic != magic || header_.version != version) {
+                return;
+            }
+            if ((size - sizeof(header)) / sizeof(record) < header_.count) {
+                return;
+            }
+            valid_ = true;
+        }
+
+        bool valid() const {
+            return valid_;
+        }
+
+        uint16_t kind() const {
+            return header_.kind;
+        }
+
+        uint32_t count() const {
+            return valid_ ? header_.count : 0;
+        }
+
+        // records may be unaligned in the buffer, they are copied out
+        record at(uint32_t index) const {
+            record result;
+            memcpy(&result, data_ + sizeof(header) + static_cast<size_t>(index) * sizeof(record),
+                   sizeof(record));
+            return result;
+        }
+
+        bool find(uint64_t name_hash, record &result) const {
+            for (uint32_t i = 0; i < count(); i++) {
+                result = at(i);
+                if (result.name_hash == name_hash) {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+    private:
+        const unsigned char *data_;
+        header header_;
+        bool valid_;
+    };
+
+}
+
+#endif //QUERY_PDB_CLIENT_QPDB_WIRE_H
@@ -9,7 +9,11 @@
 #include <utility>
 #include <httplib.h>
 #include <nlohmann/json.hpp>
+#ifdef _WIN32
 #include <windows.h>
+#else
+#include "pe_format.h"
+#endif
 
 class qpdb {
 public:
@@ -65,24 +69,7 @@ public:
     }
 
     std::map<std::string, int64_t> get_symbol(const std::set<std::string> &names) const {
-        if (!valid_) {
-            throw std::runtime_error("invalid file, cannot get pdb info");
-        }
-
-        nlohmann::json j;
-        j["name"] = info_.name;
-        j["guid"] = info_.guid;
-        j["age"] = info_.age;
-        j["query"] = names;
-
-        httplib::Client client(server_);
-        client.set_read_timeout(timeout_);
-        auto res = client.Post("/symbol", j.dump(), "application/json");
-        if (!res || res->status != 200) {
-            throw std::runtime_error("request failed");
-        }
-
-        return nlohmann::json::parse(res->body).get<std::map<std::string, int64_t>>();
+        return request("/symbol", names).get<std::map<std::string, int64_t>>();
     }
 
     int64_t get_symbol(const std::string &name) const {
@@ -91,24 +78,7 @@ public:
 
     std::map<std::string, std::map<std::string, field_info>>
     get_struct(const std::map<std::string, std::set<std::string>> &names) const {
-        if (!valid_) {
-            throw std::runtime_error("invalid file, cannot get pdb info");
-        }
-
-        nlohmann::json j;
-        j["name"] = info_.name;
-        j["guid"] = info_.guid;
-        j["age"] = info_.age;
-        j["query"] = names;
-
-        httplib::Client client(server_);
-        client.set_read_timeout(timeout_);
-        auto res = client.Post("/struct", j.dump(), "application/json");
-        if (!res || res->status != 200) {
-            throw std::runtime_error("request failed");
-        }
-
-        auto result = nlohmann::json::parse(res->body)
+        auto result = request("/struct", names)
                 .get<std::map<std::string, std::map<std::string, std::map<std::string, int64_t>>>>();
 
         std::map<std::string, std::map<std::string, field_info>> field_info_map;
@@ -134,24 +104,7 @@ public:
 
     std::map<std::string, std::map<std::string, int64_t>>
     get_enum(const std::map<std::string, std::set<std::string>> &names) const {
-        if (!valid_) {
-            throw std::runtime_error("invalid file, cannot get pdb info");
-        }
-
-        nlohmann::json j;
-        j["name"] = info_.name;
-        j["guid"] = info_.guid;
-        j["age"] = info_.age;
-        j["query"] = names;
-
-        httplib::Client client(server_);
-        client.set_read_timeout(timeout_);
-        auto res = client.Post("/enum", j.dump(), "application/json");
-        if (!res || res->status != 200) {
-            throw std::runtime_error("request failed");
-        }
-
-        return nlohmann::json::parse(res->body)
+        return request("/enum", names)
                 .get<std::map<std::string, std::map<std::string, int64_t>>>();
     }
 
@@ -185,6 +138,56 @@ private:
     bool valid_;
     uint32_t timeout_;
 
+    // results are requested as MessagePack, which is smaller and cheaper to
+    // decode than JSON, servers not supporting it still answer with JSON
+    nlohmann::json request(const std::string &path, const nlohmann::json &query) const {
+        if (!valid_) {
+            throw std::runtime_error("invalid file, cannot get pdb info");
+        }
+
+        nlohmann::json j;
+        j["name"] = info_.name;
+        j["guid"] = info_.guid;
+        j["age"] = info_.age;
+        j["query"] = query;
+
+        auto client = make_client();
+        client.set_read_timeout(timeout_);
+        httplib::Headers headers = {{"Accept", "application/msgpack"}};
+        auto res = client.Post(path, headers, j.dump(), "application/json");
+        if (!res || res->status != 200) {
+            throw std::runtime_error("request failed");
+        }
+
+        return decode(res->get_header_value("Content-Type"), res->body);
+    }
+
+    // a server on the same host can be reached through its unix socket
+    // (query-pdb --unix-socket), e.g. "unix:/run/query-pdb.sock"
+    httplib::Client make_client() const {
+        static const std::string unix_prefix = "unix:";
+        if (server_.compare(0, unix_prefix.size(), unix_prefix) != 0) {
+            return httplib::Client(server_);
+        }
+#ifdef _WIN32
+        throw std::runtime_error("unix sockets are not supported on this platform");
+#else
+        httplib::Client client(server_.substr(unix_prefix.size()), 80);
+        client.set_address_family(AF_UNIX);
+        return client;
+#endif
+    }
+
+    static nlohmann::json decode(const std::string &content_type, const std::string &body) {
+        if (content_type == "application/msgpack") {
+            return nlohmann::json::from_msgpack(body);
+        }
+        if (content_type == "application/cbor") {
+            return nlohmann::json::from_cbor(body);
+        }
+        return nlohmann::json::parse(body);
+    }
+
     static pdb_path_info parse_raw_debug_info(raw_debug_info *raw) {
         pdb_path_info result;
         result.name = raw->pdb_file_name;
@@ -12,7 +12,7 @@ MemoryMappedFile::Handle MemoryMappedFile::Open(const char* path)
 
 	if (file == INVALID_HANDLE_VALUE)
 	{
-		return Handle { INVALID_HANDLE_VALUE, INVALID_HANDLE_VALUE, nullptr };
+		return Handle { INVALID_HANDLE_VALUE, INVALID_HANDLE_VALUE, nullptr, 0 };
 	}
 
 	void* fileMapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
@@ -21,7 +21,7 @@ MemoryMappedFile::Handle MemoryMappedFile::Open(const char* path)
 	{
 		CloseHandle(file);
 
-		return Handle { INVALID_HANDLE_VALUE, INVALID_HANDLE_VALUE, nullptr };
+		return Handle { INVALID_HANDLE_VALUE, INVALID_HANDLE_VALUE, nullptr, 0 };
 	}
 
 	void* baseAddress = MapViewOfFile(fileMapping, FILE_MAP_READ, 0, 0, 0);
@@ -31,10 +31,21 @@ MemoryMappedFile::Handle MemoryMappedFile::Open(const char* path)
 		CloseHandle(fileMapping);
 		CloseHandle(file);
 
-		return Handle { INVALID_HANDLE_VALUE, INVALID_HANDLE_VALUE, nullptr };
+		return Handle { INVALID_HANDLE_VALUE, INVALID_HANDLE_VALUE, nullptr, 0 };
 	}
 
-	return Handle { file, fileMapping, baseAddress };
+	LARGE_INTEGER fileSize;
+
+	if (!GetFileSizeEx(file, &fileSize))
+	{
+		UnmapViewOfFile(baseAddress);
+		CloseHandle(fileMapping);
+		CloseHandle(file);
+
+		return Handle { INVALID_HANDLE_VALUE, INVALID_HANDLE_VALUE, nullptr, 0 };
+	}
+
+	return Handle { file, fileMapping, baseAddress, fileSize.QuadPart };
 #else
 	struct stat fileSb;
 
@@ -0,0 +1,37 @@
+#include <spdlog/spdlog.h>
+#include "admission_control.h"
+
+admission_control::slot::slot(std::atomic<size_t> *used)
+        : used_(used) {}
+
+admission_control::slot::slot(slot &&other) noexcept
+        : used_(other.used_) {
+    other.used_ = nullptr;
+}
+
+admission_control::slot::~slot() {
+    if (used_) {
+        (*used_)--;
+    }
+}
+
+admission_control::admission_control(size_t max_requests, size_t max_downloads, size_t max_parses,
+                                     uint32_t retry_after)
+        : limits_{{"requests", max_requests, 0},
+                  {"downloads", max_downloads, 0},
+                  {"cold parses", max_parses, 0}},
+          retry_after_(retry_after) {}
+
+admission_control::slot admission_control::admit(work kind) {
+    limit &l = limits_[static_cast<size_t>(kind)];
+    if (l.used++ >= l.max && l.max != 0) {
+        l.used--;
+        spdlog::warn("overloaded, too many {}, limit: {}", l.name, l.max);
+        throw overloaded_error(std::string("server overloaded, too many ") + l.name);
+    }
+    return slot(&l.used);
+}
+
+uint32_t admission_control::retry_after() const {
+    return retry_after_;
+}
@@ -0,0 +1,68 @@
+#ifndef QUERY_PDB_SERVER_ADMISSION_CONTROL_H
+#define QUERY_PDB_SERVER_ADMISSION_CONTROL_H
+
+#include <atomic>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+
+// thrown when the server takes no more work of a kind, answered with 503 and Retry-After
+class overloaded_error : public std::runtime_error {
+public:
+    explicit overloaded_error(const std::string &what)
+            : std::runtime_error(what) {}
+};
+
+// bounds the work waiting for or running on the parse and download threads.
+// under overload the requests beyond the limits are rejected at once instead of
+// every request getting slow. responses from the response cache need no work and
+// are never rejected, requests for parsed pdb files only count against the request limit
+class admission_control {
+public:
+    enum class work {
+        // a request handed to the work pools
+        request,
+        download,
+        // parsing a pdb that is not in the parser cache
+        parse,
+    };
+
+    // a taken unit of work, given back when destroyed
+    class slot {
+    public:
+        explicit slot(std::atomic<size_t> *used);
+
+        slot(slot &&other) noexcept;
+
+        slot(const slot &) = delete;
+
+        slot &operator=(const slot &) = delete;
+
+        ~slot();
+
+    private:
+        std::atomic<size_t> *used_;
+    };
+
+    // 0 means no limit
+    admission_control(size_t max_requests, size_t max_downloads, size_t max_parses,
+                      uint32_t retry_after);
+
+    // take a unit of kind, throws overloaded_error if the limit is reached
+    slot admit(work kind);
+
+    // seconds a rejected client should wait before trying again
+    uint32_t retry_after() const;
+
+private:
+    struct limit {
+        const char *name;
+        size_t max;
+        std::atomic<size_t> used;
+    };
+
+    limit limits_[3];
+    uint32_t retry_after_;
+};
+
+#endif //QUERY_PDB_SERVER_ADMISSION_CONTROL_H
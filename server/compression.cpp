@@ -0,0 +1,119 @@
+#include <atomic>
+#include <cctype>
+#include <cstdlib>
+#ifdef QUERY_PDB_ZLIB_SUPPORT
+#include <zlib.h>
+#endif
+#include "compression.h"
+
+static std::atomic<size_t> compress_threshold{1024};
+
+void set_compress_threshold(size_t bytes) {
+    compress_threshold = bytes;
+}
+
+bool is_compression_supported() {
+#ifdef QUERY_PDB_ZLIB_SUPPORT
+    return true;
+#else
+    return false;
+#endif
+}
+
+// q value of a coding in an Accept-Encoding header, 0 if it is not accepted
+static double get_quality(const std::string &accept_encoding, const std::string &coding) {
+    double wildcard = 0;
+    size_t pos = 0;
+    while (pos < accept_encoding.size()) {
+        size_t end = accept_encoding.find(',', pos);
+        if (end == std::string::npos) {
+            end = accept_encoding.size();
+        }
+        std::string item = accept_encoding.substr(pos, end - pos);
+        pos = end + 1;
+
+        double quality = 1;
+        size_t params = item.find(';');
+        if (params != std::string::npos) {
+            size_t q = item.find("q=", params);
+            if (q != std::string::npos) {
+                quality = std::strtod(item.c_str() + q + 2, nullptr);
+            }
+            item.erase(params);
+        }
+        item.erase(0, item.find_first_not_of(" \t"));
+        item.erase(item.find_last_not_of(" \t") + 1);
+        for (auto &c: item) {
+            c = static_cast<char>(tolower(static_cast<unsigned char>(c)));
+        }
+
+        if (item == coding) {
+            return quality;
+        }
+        if (item == "*") {
+            wildcard = quality;
+        }
+    }
+    return wildcard;
+}
+
+content_coding negotiate_coding(const httplib::Request &req, size_t body_size) {
+    size_t threshold = compress_threshold;
+    if (!is_compression_supported() || threshold == 0 || body_size < threshold) {
+        return content_coding::identity;
+    }
+
+    const std::string accept_encoding = req.get_header_value("Accept-Encoding");
+    double gzip = get_quality(accept_encoding, "gzip");
+    double deflate = get_quality(accept_encoding, "deflate");
+    if (gzip > 0 && gzip >= deflate) {
+        return content_coding::gzip;
+    }
+    if (deflate > 0) {
+        return content_coding::deflate;
+    }
+    return content_coding::identity;
+}
+
+const char *get_coding_name(content_coding coding) {
+    switch (coding) {
+        case content_coding::gzip:
+            return "gzip";
+        case content_coding::deflate:
+            return "deflate";
+        default:
+            return "identity";
+    }
+}
+
+bool compress_body(const std::string &body, content_coding coding, std::string &result) {
+#ifdef QUERY_PDB_ZLIB_SUPPORT
+    if (coding == content_coding::identity) {
+        return false;
+    }
+
+    // gzip wraps the stream in a gzip header, "deflate" in http is the zlib format
+    z_stream stream{};
+    int window_bits = coding == content_coding::gzip ? 15 + 16 : 15;
+    if (deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, window_bits, 8,
+                     Z_DEFAULT_STRATEGY) != Z_OK) {
+        return false;
+    }
+
+    result.resize(deflateBound(&stream, static_cast<uLong>(body.size())));
+    stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(body.data()));
+    stream.avail_in = static_cast<uInt>(body.size());
+    stream.next_out = reinterpret_cast<Bytef *>(&result[0]);
+    stream.avail_out = static_cast<uInt>(result.size());
+
+    int ret = deflate(&stream, Z_FINISH);
+    deflateEnd(&stream);
+    if (ret != Z_STREAM_END || stream.total_out >= body.size()) {
+        return false;
+    }
+    result.resize(stream.total_out);
+    return true;
+#else
+    return false;
+#endif
+}
@@ -0,0 +1,30 @@
+#ifndef QUERY_PDB_SERVER_COMPRESSION_H
+#define QUERY_PDB_SERVER_COMPRESSION_H
+
+#include <string>
+#include <httplib.h>
+
+// Content-Encoding of a response body. compression is done here instead of by
+// cpp-httplib (CPPHTTPLIB_ZLIB_SUPPORT, disabled in the top level CMakeLists.txt),
+// which compresses every JSON body regardless of its size and no other body
+enum class content_coding {
+    identity,
+    gzip,
+    deflate,
+};
+
+// bodies smaller than this are sent as they are, 0 disables compression
+void set_compress_threshold(size_t bytes);
+
+// false if the server was built without zlib
+bool is_compression_supported();
+
+// the coding to use for a body of the given size
+content_coding negotiate_coding(const httplib::Request &req, size_t body_size);
+
+const char *get_coding_name(content_coding coding);
+
+// false if the body could not be compressed or would not get smaller
+bool compress_body(const std::string &body, content_coding coding, std::string &result);
+
+#endif //QUERY_PDB_SERVER_COMPRESSION_H
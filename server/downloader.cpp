@@ -7,27 +7,37 @@
 #include <httplib.h>
 #include <spdlog/spdlog.h>
 #include "pdb_parser.h"
+#include "file_util.h"
 #include "downloader.h"
 
-downloader::downloader(std::string path, std::string server)
+downloader::downloader(std::string path, std::vector<std::string> servers)
         : valid_(false),
           path_(std::move(path)),
-          server_(std::move(server)) {
+          objects_(path_),
+          index_(path_) {
 
-    spdlog::info("create downloader, path: {}, server: {}", path_, server_);
-    if (server_.empty() || path_.empty()) {
-        spdlog::error("invalid downloader, path: {}, server: {}", path_, server_);
+    spdlog::info("create downloader, path: {}", path_);
+    if (servers.empty() || path_.empty()) {
+        spdlog::error("invalid downloader, path: {}, server count: {}", path_, servers.size());
         return;
     }
-    if (server_.back() != '/') {
-        server_.push_back('/');
+
+    for (auto &server: servers) {
+        upstream result{};
+        if (!parse_upstream(std::move(server), result)) {
+            spdlog::error("invalid server: {}", result.url);
+            return;
+        }
+        spdlog::info("add upstream server: {}{}", result.url,
+                     result.two_tier ? " (two-tier)" : "");
+        upstreams_.push_back(std::move(result));
     }
 
-    server_split_ = split_server_name();
-    if (server_split_.first.empty()) {
-        spdlog::error("split server name failed, server: {}", server_);
-        return;
+    size_t removed = objects_.collect_garbage();
+    if (removed) {
+        spdlog::info("removed {} unreferenced objects", removed);
     }
+    spdlog::info("found {} cached pdb files", index_.load());
 
     valid_ = true;
 }
@@ -36,17 +46,100 @@ bool downloader::valid() const {
     return valid_;
 }
 
-bool downloader::download(const std::string &name, const std::string &guid, uint32_t age) {
+bool downloader::watch() {
+    return index_.watch();
+}
+
+bool downloader::download(const std::string &name, const std::string &guid, uint32_t age,
+                          pdb_location &location) {
+    // warm path, no file system access
+    if (index_.find(name, guid, age, location)) {
+        return true;
+    }
+
     std::string relative_path = get_relative_path_str(name, guid, age);
     auto path = get_path(name, guid, age);
     spdlog::info("lookup pdb, path: {}", relative_path);
 
+    // added by another tool while not watching the directory
     if (std::filesystem::exists(path)) {
         spdlog::info("pdb already exists, path: {}", relative_path);
-        return true;
+        index_.insert(name, guid, age, path);
+    } else if (!download_impl(name, guid, age)) {
+        return false;
+    }
+
+    return index_.find(name, guid, age, location);
+}
+
+bool downloader::find(const std::string &name, const std::string &guid, uint32_t age,
+                      pdb_location &location) {
+    return index_.find(name, guid, age, location);
+}
+
+bool downloader::recover(const std::string &name, const std::string &guid, uint32_t age,
+                         pdb_location &location) {
+    file_id id{};
+    if (get_file_id(location.path, id) && id == location.id) {
+        return false;
     }
+    spdlog::warn("pdb changed in download path, path: {}", get_relative_path_str(name, guid, age));
+    index_.remove(name, guid, age);
+    return download(name, guid, age, location);
+}
 
-    return download_impl(name, guid, age);
+static bool equals_ignore_case(const std::string &a, const std::string &b) {
+    return std::equal(a.begin(), a.end(), b.begin(), b.end(), [](char x, char y) {
+        return toupper(static_cast<unsigned char>(x)) == toupper(static_cast<unsigned char>(y));
+    });
+}
+
+bool downloader::store(const std::string &name, const std::string &guid, uint32_t age,
+                       const std::function<bool(std::ofstream &)> &writer) {
+    std::string relative_path = get_relative_path_str(name, guid, age);
+    auto path = get_path(name, guid, age);
+    spdlog::info("store pdb, path: {}", relative_path);
+
+    // every store gets its own temporary file, concurrent uploads of
+    // the same pdb must not write into each other
+    std::error_code ec;
+    std::filesystem::create_directories(path.parent_path(), ec);
+    auto tmp_path = get_unique_tmp_path(path);
+
+    std::ofstream f(tmp_path, std::ios::binary);
+    if (!f.is_open()) {
+        spdlog::error("failed to open file, path: {}", tmp_path.string());
+        return false;
+    }
+    bool written = writer(f);
+    f.close();
+    if (!written || f.fail()) {
+        spdlog::error("failed to write pdb, path: {}", relative_path);
+        std::filesystem::remove(tmp_path, ec);
+        return false;
+    }
+
+    bool valid = false;
+    try {
+        pdb_info info = pdb_parser(tmp_path.string()).get_info();
+        valid = info.age == age && equals_ignore_case(info.guid, guid) &&
+                is_valid_pdb(name, tmp_path);
+    } catch (std::exception &e) {
+        spdlog::error("failed to parse stored pdb, path: {}, error: {}", relative_path, e.what());
+    }
+    if (!valid) {
+        spdlog::error("stored pdb file is invalid, path: {}", relative_path);
+        std::filesystem::remove(tmp_path, ec);
+        return false;
+    }
+
+    if (!objects_.insert(tmp_path, path, true)) {
+        spdlog::error("failed to store pdb, path: {}", relative_path);
+        return false;
+    }
+    index_.insert(name, guid, age, path);
+    spdlog::info("store pdb success, path: {}", relative_path);
+    return true;
 }
 
 static std::string to_upper(const std::string &s) {
@@ -76,15 +169,69 @@ downloader::get_path(const std::string &name, const std::string &guid, uint32_t
     return path;
 }
 
-bool downloader::download_impl(const std::string &name, const std::string &guid, uint32_t age) {
+std::shared_ptr<std::mutex> downloader::get_download_lock(const std::string &relative_path) {
     std::lock_guard lock(mutex_);
+
+    // drop the locks of finished downloads
+    for (auto it = download_locks_.begin(); it != download_locks_.end();) {
+        if (it->second.expired()) {
+            it = download_locks_.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    auto &weak = download_locks_[relative_path];
+    auto result = weak.lock();
+    if (!result) {
+        result = std::make_shared<std::mutex>();
+        weak = result;
+    }
+    return result;
+}
+
+bool downloader::download_impl(const std::string &name, const std::string &guid, uint32_t age) {
+    auto download_lock = get_download_lock(get_relative_path_str(name, guid, age));
+    std::lock_guard lock(*download_lock);
+
+    // downloaded by another request while waiting for the lock
+    pdb_location location;
+    if (index_.find(name, guid, age, location)) {
+        return true;
+    }
+
+    // other workers sharing the download path lock the directory of the pdb,
+    // the one holding it downloads and the others find the file afterwards
+    auto path = get_path(name, guid, age);
+    std::error_code ec;
+    std::filesystem::create_directories(path.parent_path(), ec);
+    file_lock directory_lock(path.parent_path());
+    if (std::filesystem::exists(path, ec)) {
+        spdlog::info("pdb downloaded by another worker, path: {}", get_relative_path_str(name, guid, age));
+        index_.insert(name, guid, age, path);
+        return true;
+    }
+
+    for (const auto &server: upstreams_) {
+        bool success = server.local ?
+                       fetch_local(server, name, guid, age) :
+                       fetch_remote(server, name, guid, age);
+        if (success) {
+            index_.insert(name, guid, age, path);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool downloader::fetch_remote(const upstream &server,
+                              const std::string &name, const std::string &guid, uint32_t age) {
     std::string relative_path = get_relative_path_str(name, guid, age);
-    spdlog::info("download pdb, path: {}", relative_path);
+    spdlog::info("download pdb, server: {}, path: {}", server.url, relative_path);
 
-    std::string buf;
-    httplib::Client client(server_split_.first);
+    httplib::Client client(server.host);
     client.set_follow_location(true);
-    auto res = client.Get(server_split_.second + relative_path);
+    auto res = client.Get(server.base + relative_path);
     if (!res || res->status != 200) {
         spdlog::error("failed to download pdb, path: {}", relative_path);
         return false;
@@ -100,10 +247,11 @@ bool downloader::download_impl(const std::string &name, const std::string &guid,
         return false;
     }
 
+    // the workers of one download path never write into each other's file
     auto path = std::filesystem::path(path_).append(relative_path);
-    std::filesystem::create_directories(path.parent_path());
-    auto tmp_path = path;
-    tmp_path.replace_extension(".tmp");
+    std::error_code ec;
+    std::filesystem::create_directories(path.parent_path(), ec);
+    auto tmp_path = get_unique_tmp_path(path);
     std::ofstream f(tmp_path, std::ios::binary);
     if (!f.is_open()) {
         spdlog::error("failed to open file, path: {}", tmp_path.string());
@@ -111,26 +259,111 @@ bool downloader::download_impl(const std::string &name, const std::string &guid,
     }
     f.write(res->body.c_str(), static_cast<std::streamsize>(res->body.size()));
     f.close();
+    if (f.fail()) {
+        spdlog::error("failed to write pdb, path: {}", relative_path);
+        std::filesystem::remove(tmp_path, ec);
+        return false;
+    }
 
-    if (!is_valid_pdb(name, tmp_path)) {
+    bool valid = false;
+    try {
+        valid = is_valid_pdb(name, tmp_path);
+    } catch (std::exception &e) {
+        spdlog::error("failed to parse downloaded pdb, path: {}, error: {}", relative_path, e.what());
+    }
+    if (!valid) {
         spdlog::error("downloaded pdb file is invalid, path: {}", relative_path);
+        std::filesystem::remove(tmp_path, ec);
         return false;
     }
 
-    std::filesystem::rename(tmp_path, path);
+    if (!objects_.insert(tmp_path, path, true)) {
+        spdlog::error("failed to store downloaded pdb, path: {}", relative_path);
+        std::filesystem::remove(tmp_path, ec);
+        return false;
+    }
     spdlog::info("download pdb success, path: {}", relative_path);
     return true;
 }
 
-std::pair<std::string, std::string> downloader::split_server_name() {
+bool downloader::fetch_local(const upstream &server,
+                             const std::string &name, const std::string &guid, uint32_t age) {
+    std::string relative_path = get_relative_path_str(name, guid, age);
+
+    // two-tier stores put every file under a directory named by
+    // the first two characters of the file name
+    auto source = std::filesystem::path(server.base);
+    if (server.two_tier) {
+        source.append(name.substr(0, 2));
+    }
+    source.append(relative_path);
+
+    std::error_code ec;
+    if (!std::filesystem::is_regular_file(source, ec)) {
+        spdlog::info("pdb not found in local store, server: {}, path: {}",
+                     server.url, relative_path);
+        return false;
+    }
+
+    // validate in place, the cache only ever receives usable files. a damaged file
+    // must not end the search, the next upstream may have a good copy
+    bool valid = false;
+    try {
+        valid = is_valid_pdb(name, source);
+    } catch (std::exception &e) {
+        spdlog::error("failed to parse local pdb, path: {}, error: {}", source.string(), e.what());
+    }
+    if (!valid) {
+        spdlog::error("local pdb file is invalid, path: {}", source.string());
+        return false;
+    }
+
+    if (!objects_.insert(source, get_path(name, guid, age), false)) {
+        spdlog::error("failed to place local pdb into cache, path: {}", source.string());
+        return false;
+    }
+    spdlog::info("link pdb success, from: {}, path: {}", source.string(), relative_path);
+    return true;
+}
+
+bool downloader::parse_upstream(std::string url, upstream &result) {
+    if (!url.empty() && url.back() != '/') {
+        url.push_back('/');
+    }
+    result.url = url;
+
+    static const std::string file_scheme = "file://";
+    if (url.compare(0, file_scheme.size(), file_scheme) == 0) {
+        std::string root = url.substr(file_scheme.size());
+#ifdef _WIN32
+        // file:///C:/symbols/
+        if (root.size() > 2 && root[0] == '/' && root[2] == ':') {
+            root.erase(0, 1);
+        }
+#endif
+        std::error_code ec;
+        if (root.empty() || !std::filesystem::is_directory(root, ec)) {
+            return false;
+        }
+
+        result.local = true;
+        result.base = root;
+        result.two_tier = std::filesystem::exists(
+                std::filesystem::path(root).append("index2.txt"), ec);
+        return true;
+    }
+
     std::regex regex(R"(^((?:(?:http|https):\/\/)?[^\/]+)(\/.*)$)");
     std::smatch match;
 
-    if (!std::regex_match(server_, match, regex)) {
-        return {};
+    if (!std::regex_match(url, match, regex)) {
+        return false;
     }
 
-    return {match[1].str(), match[2].str()};
+    result.local = false;
+    result.host = match[1].str();
+    result.base = match[2].str();
+    return true;
 }
 
 bool downloader::is_valid_pdb(const std::string &name, const std::filesystem::path &path) {
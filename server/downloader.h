@@ -2,35 +2,87 @@
 #define QUERY_PDB_SERVER_DOWNLOADER_H
 
 #include <string>
+#include <vector>
+#include <map>
+#include <memory>
 #include <mutex>
+#include <fstream>
+#include <functional>
 #include <filesystem>
+#include "object_store.h"
+#include "presence_index.h"
 
 class downloader {
 public:
-    downloader(std::string path, std::string server);
+    downloader(std::string path, std::vector<std::string> servers);
 
     bool valid() const;
 
-    bool download(const std::string &name, const std::string &guid, uint32_t age);
+    // keep the cache index current with files added by other tools (linux only)
+    bool watch();
+
+    bool download(const std::string &name, const std::string &guid, uint32_t age,
+                  pdb_location &location);
+
+    // find a pdb file that is already in the download path, never downloads
+    // and never touches the file system
+    bool find(const std::string &name, const std::string &guid, uint32_t age,
+              pdb_location &location);
+
+    // the indexed file at location failed to open. if it was removed or replaced in the
+    // download path since (e.g. by cleaning the cache without watching it), the entry is
+    // dropped and the pdb found or downloaded again. false if the file is unchanged or
+    // the download fails
+    bool recover(const std::string &name, const std::string &guid, uint32_t age,
+                 pdb_location &location);
+
+    // store a pdb file produced by writer (e.g. streamed from an upload request),
+    // the file must match name, guid and age and becomes visible atomically
+    bool store(const std::string &name, const std::string &guid, uint32_t age,
+               const std::function<bool(std::ofstream &)> &writer);
 
     std::filesystem::path
     get_path(const std::string &name, const std::string &guid, uint32_t age);
 
+    static std::string
+    get_relative_path_str(const std::string &name, const std::string &guid, uint32_t age);
+
+    static bool is_valid_pdb(const std::string &name, const std::filesystem::path &path);
+
 private:
+    // an upstream symbol store, either a symbol server reached over http(s)
+    // or a local (possibly network mounted) SymStore directory given as file://
+    struct upstream {
+        std::string url;
+        bool local;
+        // http(s): scheme + host, local: unused
+        std::string host;
+        // http(s): path prefix on the host, local: root directory of the store
+        std::string base;
+        // local: the store uses the two-tier layout (index2.txt)
+        bool two_tier;
+    };
+
     bool valid_;
     std::string path_;
-    std::string server_;
-    std::pair<std::string, std::string> server_split_;
+    std::vector<upstream> upstreams_;
+    object_store objects_;
+    presence_index index_;
+    // one lock per pdb being downloaded, different pdb files download in parallel
     std::mutex mutex_;
+    std::map<std::string, std::weak_ptr<std::mutex>> download_locks_;
 
-    static std::string
-    get_relative_path_str(const std::string &name, const std::string &guid, uint32_t age);
+    std::shared_ptr<std::mutex> get_download_lock(const std::string &relative_path);
 
     bool download_impl(const std::string &name, const std::string &guid, uint32_t age);
 
-    std::pair<std::string, std::string> split_server_name();
+    bool fetch_remote(const upstream &server,
+                      const std::string &name, const std::string &guid, uint32_t age);
+
+    bool fetch_local(const upstream &server,
+                     const std::string &name, const std::string &guid, uint32_t age);
 
-    bool is_valid_pdb(const std::string &name, const std::filesystem::path &path);
+    static bool parse_upstream(std::string url, upstream &result);
 };
 
 #endif //QUERY_PDB_SERVER_DOWNLOADER_H
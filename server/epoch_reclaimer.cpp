@@ -0,0 +1,135 @@
+#include <limits>
+#include <thread>
+#include "epoch_reclaimer.h"
+
+epoch_reclaimer::guard::guard(guard &&other) noexcept
+        : owner_(other.owner_),
+          reservation_(other.reservation_),
+          shared_(other.shared_) {
+    other.owner_ = nullptr;
+    other.reservation_ = nullptr;
+    other.shared_ = false;
+}
+
+epoch_reclaimer::guard &epoch_reclaimer::guard::operator=(guard &&other) noexcept {
+    if (this != &other) {
+        leave();
+        owner_ = other.owner_;
+        reservation_ = other.reservation_;
+        shared_ = other.shared_;
+        other.owner_ = nullptr;
+        other.reservation_ = nullptr;
+        other.shared_ = false;
+    }
+    return *this;
+}
+
+epoch_reclaimer::guard::~guard() {
+    leave();
+}
+
+void epoch_reclaimer::guard::leave() {
+    if (!reservation_) {
+        return;
+    }
+    if (shared_) {
+        std::lock_guard lock(owner_->shared_mutex_);
+        if (--owner_->shared_count_ == 0) {
+            reservation_->store(0);
+        }
+    } else {
+        reservation_->store(0);
+    }
+    // the last guard holding retired data back frees it, unless a writer is busy
+    // with the list, a reader never waits
+    if (owner_->pending_.load(std::memory_order_relaxed)) {
+        std::unique_lock lock(owner_->retired_mutex_, std::try_to_lock);
+        if (lock.owns_lock()) {
+            owner_->collect(lock);
+        }
+    }
+    owner_ = nullptr;
+    reservation_ = nullptr;
+    shared_ = false;
+}
+
+epoch_reclaimer::epoch_reclaimer()
+        : epoch_(1),
+          reservations_(std::make_unique<reservation[]>(reservation_count)),
+          shared_count_(0),
+          pending_(false) {}
+
+epoch_reclaimer::~epoch_reclaimer() {
+    for (auto &[epoch, free]: retired_) {
+        free();
+    }
+}
+
+epoch_reclaimer::guard epoch_reclaimer::enter() {
+    // every thread starts looking at its own place, guards rarely meet
+    thread_local size_t hint = std::hash<std::thread::id>()(std::this_thread::get_id());
+    guard g;
+    g.owner_ = this;
+    for (size_t i = 0; i < reservation_count; i++) {
+        std::atomic<uint64_t> &epoch = reservations_[(hint + i) % reservation_count].epoch;
+        uint64_t expected = 0;
+        // a writer retiring after this load finds the reservation and keeps the data
+        if (epoch.load(std::memory_order_relaxed) == 0 && epoch.compare_exchange_strong(expected, epoch_.load())) {
+            g.reservation_ = &epoch;
+            return g;
+        }
+    }
+
+    // a guard may be held while waiting for work that needs a guard of its own,
+    // waiting for a free reservation could deadlock
+    std::lock_guard lock(shared_mutex_);
+    if (shared_count_++ == 0) {
+        shared_reservation_.epoch.store(epoch_.load());
+    }
+    g.reservation_ = &shared_reservation_.epoch;
+    g.shared_ = true;
+    return g;
+}
+
+void epoch_reclaimer::retire(std::function<void()> free) {
+    std::unique_lock lock(retired_mutex_);
+    // guards entered from now on reserve a newer epoch, they cannot reach the data
+    retired_.emplace_back(epoch_.fetch_add(1), std::move(free));
+    pending_ = true;
+    collect(lock);
+}
+
+void epoch_reclaimer::collect() {
+    std::unique_lock lock(retired_mutex_);
+    collect(lock);
+}
+
+void epoch_reclaimer::collect(std::unique_lock<std::mutex> &lock) {
+    uint64_t oldest = shared_reservation_.epoch.load();
+    if (oldest == 0) {
+        oldest = std::numeric_limits<uint64_t>::max();
+    }
+    for (size_t i = 0; i < reservation_count; i++) {
+        uint64_t epoch = reservations_[i].epoch.load();
+        if (epoch != 0 && epoch < oldest) {
+            oldest = epoch;
+        }
+    }
+
+    std::vector<std::function<void()>> unreachable;
+    for (auto it = retired_.begin(); it != retired_.end();) {
+        if (it->first < oldest) {
+            unreachable.push_back(std::move(it->second));
+            it = retired_.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    pending_ = !retired_.empty();
+
+    // freeing may unmap files, the list is free for others meanwhile
+    lock.unlock();
+    for (auto &free: unreachable) {
+        free();
+    }
+}
@@ -0,0 +1,84 @@
+#ifndef QUERY_PDB_SERVER_EPOCH_RECLAIMER_H
+#define QUERY_PDB_SERVER_EPOCH_RECLAIMER_H
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// epoch based reclamation for data that readers use without a lock. a reader holds a
+// guard while it uses what it found, a writer unlinks data first and then retires it.
+// retired data is freed once every guard that may have seen it is gone: a guard
+// reserves the epoch it was entered in, retiring advances the epoch, so data retired
+// in an epoch older than every reserved one is unreachable.
+// entering and leaving take no lock, a reader only writes to its own reservation.
+// when every reservation is taken, further guards share one behind a mutex
+class epoch_reclaimer {
+public:
+    class guard {
+    public:
+        guard() = default;
+
+        guard(guard &&other) noexcept;
+
+        guard &operator=(guard &&other) noexcept;
+
+        ~guard();
+
+    private:
+        friend class epoch_reclaimer;
+
+        epoch_reclaimer *owner_ = nullptr;
+        std::atomic<uint64_t> *reservation_ = nullptr;
+        // the guard counts in the shared reservation of owner_
+        bool shared_ = false;
+
+        void leave();
+    };
+
+    epoch_reclaimer();
+
+    // frees everything still retired, no guard may be left
+    ~epoch_reclaimer();
+
+    epoch_reclaimer(const epoch_reclaimer &) = delete;
+
+    epoch_reclaimer &operator=(const epoch_reclaimer &) = delete;
+
+    // everything loaded while the guard lives stays valid, guards may move between threads
+    guard enter();
+
+    // free is called once no guard entered before this call is left
+    void retire(std::function<void()> free);
+
+    // free what no guard can see anymore, done on retire and when the last
+    // guard that held it back leaves
+    void collect();
+
+private:
+    // one cache line per reservation, readers do not share lines
+    struct alignas(64) reservation {
+        // 0 is free, otherwise the epoch the guard was entered in
+        std::atomic<uint64_t> epoch{0};
+    };
+
+    static constexpr size_t reservation_count = 512;
+
+    std::atomic<uint64_t> epoch_;
+    std::unique_ptr<reservation[]> reservations_;
+    // for guards that found no free reservation, holds the epoch of the first one
+    // entered until the last one leaves, a reader never waits for a reservation
+    std::mutex shared_mutex_;
+    size_t shared_count_;
+    reservation shared_reservation_;
+    // something is retired, checked by leaving guards
+    std::atomic<bool> pending_;
+    std::mutex retired_mutex_;
+    std::vector<std::pair<uint64_t, std::function<void()>>> retired_;
+
+    void collect(std::unique_lock<std::mutex> &lock);
+};
+
+#endif //QUERY_PDB_SERVER_EPOCH_RECLAIMER_H
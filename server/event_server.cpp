@@ -0,0 +1,792 @@
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+#include <spdlog/spdlog.h>
+#ifdef __linux__
+#include <netdb.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+#include "event_server.h"
+
+// request line and headers, longer ones are not read any further
+static constexpr size_t max_header_size = 64 * 1024;
+
+namespace {
+
+// a buffered request and its response as the stream httplib reads and writes,
+// the request is the first size bytes of input
+class request_stream : public httplib::Stream {
+public:
+    request_stream(const std::string &input, size_t size, std::string &output,
+                   const std::string &remote_ip, int remote_port,
+                   const std::string &local_ip, int local_port)
+            : input_(input),
+              size_(size),
+              position_(0),
+              output_(output),
+              remote_ip_(remote_ip),
+              remote_port_(remote_port),
+              local_ip_(local_ip),
+              local_port_(local_port) {}
+
+    bool is_readable() const override {
+        return true;
+    }
+
+    bool is_writable() const override {
+        return true;
+    }
+
+    ssize_t read(char *ptr, size_t size) override {
+        size = std::min(size, size_ - position_);
+        memcpy(ptr, input_.data() + position_, size);
+        position_ += size;
+        return static_cast<ssize_t>(size);
+    }
+
+    ssize_t write(const char *ptr, size_t size) override {
+        output_.append(ptr, size);
+        return static_cast<ssize_t>(size);
+    }
+
+    void get_remote_ip_and_port(std::string &ip, int &port) const override {
+        ip = remote_ip_;
+        port = remote_port_;
+    }
+
+    void get_local_ip_and_port(std::string &ip, int &port) const override {
+        ip = local_ip_;
+        port = local_port_;
+    }
+
+    // not a socket, also keeps httplib from comparing it with FD_SETSIZE
+    socket_t socket() const override {
+        return INVALID_SOCKET;
+    }
+
+private:
+    const std::string &input_;
+    size_t size_;
+    size_t position_;
+    std::string &output_;
+    const std::string &remote_ip_;
+    int remote_port_;
+    const std::string &local_ip_;
+    int local_port_;
+};
+
+// a streamed request, what the loop buffered and then the socket itself. the handler
+// thread waits for the socket up to the timeouts, the response goes straight to it
+class socket_stream : public httplib::Stream {
+public:
+    socket_stream(int fd, std::string &input, int read_timeout_ms, int write_timeout_ms,
+                  const std::string &remote_ip, int remote_port,
+                  const std::string &local_ip, int local_port)
+            : fd_(fd),
+              input_(input),
+              position_(0),
+              read_timeout_ms_(read_timeout_ms),
+              write_timeout_ms_(write_timeout_ms),
+              remote_ip_(remote_ip),
+              remote_port_(remote_port),
+              local_ip_(local_ip),
+              local_port_(local_port) {}
+
+    bool is_readable() const override {
+        return true;
+    }
+
+    bool is_writable() const override {
+        return true;
+    }
+
+    ssize_t read(char *ptr, size_t size) override {
+        if (position_ == input_.size()) {
+            // the buffer is used up, it takes the next read from the socket
+            input_.clear();
+            position_ = 0;
+            ssize_t n = receive();
+            if (n <= 0) {
+                return n;
+            }
+        }
+        size = std::min(size, input_.size() - position_);
+        memcpy(ptr, input_.data() + position_, size);
+        position_ += size;
+        return static_cast<ssize_t>(size);
+    }
+
+    ssize_t write(const char *ptr, size_t size) override {
+#ifdef __linux__
+        size_t written = 0;
+        while (written < size) {
+            ssize_t n = send(fd_, ptr + written, size - written, MSG_NOSIGNAL);
+            if (n == -1 && errno == EINTR) {
+                continue;
+            }
+            if (n == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                pollfd pfd{fd_, POLLOUT, 0};
+                if (poll(&pfd, 1, write_timeout_ms_) <= 0) {
+                    return -1;
+                }
+                continue;
+            }
+            if (n == -1) {
+                return -1;
+            }
+            written += static_cast<size_t>(n);
+        }
+        return static_cast<ssize_t>(size);
+#else
+        (void) ptr;
+        (void) size;
+        return -1;
+#endif
+    }
+
+    void get_remote_ip_and_port(std::string &ip, int &port) const override {
+        ip = remote_ip_;
+        port = remote_port_;
+    }
+
+    void get_local_ip_and_port(std::string &ip, int &port) const override {
+        ip = local_ip_;
+        port = local_port_;
+    }
+
+    socket_t socket() const override {
+        return INVALID_SOCKET;
+    }
+
+private:
+    int fd_;
+    std::string &input_;
+    size_t position_;
+    int read_timeout_ms_;
+    int write_timeout_ms_;
+    const std::string &remote_ip_;
+    int remote_port_;
+    const std::string &local_ip_;
+    int local_port_;
+
+    // what the socket has, 0 if the peer closed it and -1 on a timeout or an error
+    ssize_t receive() {
+#ifdef __linux__
+        char buffer[16 * 1024];
+        while (true) {
+            ssize_t n = recv(fd_, buffer, sizeof(buffer), 0);
+            if (n == -1 && errno == EINTR) {
+                continue;
+            }
+            if (n == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                pollfd pfd{fd_, POLLIN, 0};
+                if (poll(&pfd, 1, read_timeout_ms_) <= 0) {
+                    return -1;
+                }
+                continue;
+            }
+            if (n > 0) {
+                input_.append(buffer, static_cast<size_t>(n));
+            }
+            return n;
+        }
+#else
+        return -1;
+#endif
+    }
+};
+
+}
+
+static bool equals_ignore_case(std::string_view a, std::string_view b) {
+    return std::equal(a.begin(), a.end(), b.begin(), b.end(), [](char x, char y) {
+        return tolower(static_cast<unsigned char>(x)) == tolower(static_cast<unsigned char>(y));
+    });
+}
+
+static std::string_view trim(std::string_view s) {
+    while (!s.empty() && (s.front() == ' ' || s.front() == '\t')) {
+        s.remove_prefix(1);
+    }
+    while (!s.empty() && (s.back() == ' ' || s.back() == '\t')) {
+        s.remove_suffix(1);
+    }
+    return s;
+}
+
+// requests answered on one connection before it is closed, an idle connection costs
+// the loops nothing, clients may keep theirs for long
+static constexpr size_t keep_alive_requests = 1000;
+
+// a chunk size line or a trailer, a longer one is not waited for
+static constexpr size_t max_chunk_line_size = 1024;
+
+// goes on parsing the chunked body in input where framing left off, every chunk is
+// looked at once. returns the size of the request once the body is complete, 0 while
+// it is not and npos if it is malformed or larger than max_body_size (too_large set)
+static size_t parse_chunked(const std::string &input, size_t header_size, size_t &position,
+                            bool &trailers, size_t max_body_size, bool &too_large) {
+    while (true) {
+        size_t line_end = input.find("\r\n", position);
+        if (line_end == std::string::npos) {
+            return input.size() - position > max_chunk_line_size ? std::string::npos : 0;
+        }
+        if (line_end - position > max_chunk_line_size) {
+            return std::string::npos;
+        }
+
+        if (trailers) {
+            // trailers up to an empty line
+            bool empty = line_end == position;
+            position = line_end + 2;
+            if (empty) {
+                return position;
+            }
+            continue;
+        }
+
+        char *end = nullptr;
+        auto chunk_size = strtoull(input.c_str() + position, &end, 16);
+        if (end == input.c_str() + position) {
+            return std::string::npos;
+        }
+        if (chunk_size == 0) {
+            trailers = true;
+            position = line_end + 2;
+            continue;
+        }
+        // framing included, a body that goes over is rejected before it is read
+        if (chunk_size > max_body_size || line_end + 2 - header_size + chunk_size > max_body_size) {
+            too_large = true;
+            return std::string::npos;
+        }
+
+        size_t data = line_end + 2;
+        if (input.size() - data < chunk_size + 2) {
+            return 0;
+        }
+        if (input.compare(data + chunk_size, 2, "\r\n") != 0) {
+            return std::string::npos;
+        }
+        position = data + chunk_size + 2;
+    }
+}
+
+event_server::event_server(size_t loop_threads, size_t handler_threads, std::chrono::seconds idle_timeout,
+                           size_t max_body_size)
+        : handler_threads_(handler_threads),
+          idle_timeout_(idle_timeout),
+          max_body_size_(max_body_size),
+          listen_fd_(-1),
+          stop_fd_(-1),
+          stopping_(false) {
+    for (size_t i = 0; i < std::max<size_t>(1, loop_threads); i++) {
+        loops_.push_back(std::make_unique<loop>());
+    }
+}
+
+event_server::~event_server() {
+    stop_events();
+}
+
+bool event_server::is_supported() {
+#ifdef __linux__
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool event_server::listen_events(const std::string &ip, uint16_t port) {
+#ifdef __linux__
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_PASSIVE;
+    addrinfo *result = nullptr;
+    if (getaddrinfo(ip.c_str(), std::to_string(port).c_str(), &hints, &result) != 0) {
+        spdlog::error("failed to resolve listen address, ip: {}", ip);
+        return false;
+    }
+
+    listen_fd_ = socket(result->ai_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    int yes = 1;
+    bool listening = listen_fd_ != -1 &&
+                     setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes)) == 0 &&
+                     setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEPORT, &yes, sizeof(yes)) == 0 &&
+                     bind(listen_fd_, result->ai_addr, result->ai_addrlen) == 0 &&
+                     ::listen(listen_fd_, SOMAXCONN) == 0;
+    freeaddrinfo(result);
+    if (!listening) {
+        spdlog::error("failed to listen, ip: {}, port: {}, error: {}", ip, port, strerror(errno));
+        return false;
+    }
+
+    // the Keep-Alive header of the responses tells what the loops enforce
+    set_keep_alive_timeout(idle_timeout_.count());
+    set_keep_alive_max_count(keep_alive_requests);
+    handlers_ = std::make_unique<work_pool>(handler_threads_);
+    stop_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    for (auto &l: loops_) {
+        l->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+
+        // every loop accepts, the kernel wakes only one of them per connection
+        epoll_event event{};
+        event.events = EPOLLIN | EPOLLEXCLUSIVE;
+        event.data.ptr = nullptr;
+        epoll_ctl(l->epoll_fd, EPOLL_CTL_ADD, listen_fd_, &event);
+
+        event.events = EPOLLIN;
+        event.data.ptr = &stop_fd_;
+        epoll_ctl(l->epoll_fd, EPOLL_CTL_ADD, stop_fd_, &event);
+    }
+    spdlog::info("listen with event loops, ip: {}, port: {}, loops: {}", ip, port, loops_.size());
+
+    for (auto &l: loops_) {
+        l->thread = std::thread(&event_server::run_loop, this, std::ref(*l));
+    }
+    for (auto &l: loops_) {
+        l->thread.join();
+    }
+
+    // handlers still running rearm their connections, close them afterwards
+    handlers_->shutdown();
+    for (auto &l: loops_) {
+        for (auto &[fd, c]: l->connections) {
+            close(fd);
+        }
+        l->connections.clear();
+        close(l->epoll_fd);
+        l->epoll_fd = -1;
+    }
+    close(stop_fd_);
+    close(listen_fd_);
+    stop_fd_ = -1;
+    listen_fd_ = -1;
+    return true;
+#else
+    (void) ip;
+    (void) port;
+    return false;
+#endif
+}
+
+void event_server::stop_events() {
+#ifdef __linux__
+    if (!stopping_.exchange(true) && stop_fd_ != -1) {
+        uint64_t value = 1;
+        (void) !write(stop_fd_, &value, sizeof(value));
+    }
+#endif
+}
+
+void event_server::stream_body(const std::string &method, const std::string &pattern) {
+    streamed_routes_.emplace_back(method, std::regex(pattern));
+}
+
+void event_server::run_loop(loop &l) {
+#ifdef __linux__
+    epoll_event events[64];
+    auto last_sweep = std::chrono::steady_clock::now();
+    while (!stopping_) {
+        int count = epoll_wait(l.epoll_fd, events, std::size(events), 1000);
+        for (int i = 0; i < count; i++) {
+            if (events[i].data.ptr == nullptr) {
+                accept_connections(l);
+            } else if (events[i].data.ptr != &stop_fd_) {
+                on_event(l, *static_cast<connection *>(events[i].data.ptr), events[i].events);
+            }
+        }
+
+        auto now = std::chrono::steady_clock::now();
+        if (now - last_sweep >= std::chrono::seconds(1)) {
+            close_idle(l);
+            last_sweep = now;
+        }
+    }
+#else
+    (void) l;
+#endif
+}
+
+void event_server::accept_connections(loop &l) {
+#ifdef __linux__
+    while (true) {
+        int fd = accept4(listen_fd_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd == -1) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                spdlog::warn("failed to accept connection, error: {}", strerror(errno));
+            }
+            return;
+        }
+        int yes = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes));
+
+        auto c = std::make_unique<connection>();
+        c->fd = fd;
+        httplib::detail::get_remote_ip_and_port(fd, c->remote_ip, c->remote_port);
+        httplib::detail::get_local_ip_and_port(fd, c->local_ip, c->local_port);
+        c->last_active = std::chrono::steady_clock::now();
+        c->busy = false;
+        c->close_after = false;
+        c->continued = false;
+        c->requests = 0;
+
+        epoll_event event{};
+        event.events = EPOLLIN | EPOLLONESHOT;
+        event.data.ptr = c.get();
+        std::lock_guard lock(l.mutex);
+        if (epoll_ctl(l.epoll_fd, EPOLL_CTL_ADD, fd, &event) == -1) {
+            close(fd);
+            continue;
+        }
+        l.connections.emplace(fd, std::move(c));
+    }
+#else
+    (void) l;
+#endif
+}
+
+// write as much of the pending output as the socket takes, false if the connection is broken
+static bool write_output(int fd, std::string &output) {
+#ifdef __linux__
+    size_t written = 0;
+    while (written < output.size()) {
+        ssize_t n = send(fd, output.data() + written, output.size() - written, MSG_NOSIGNAL);
+        if (n == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                return false;
+            }
+            break;
+        }
+        written += static_cast<size_t>(n);
+    }
+    output.erase(0, written);
+    return true;
+#else
+    (void) fd;
+    (void) output;
+    return false;
+#endif
+}
+
+// read what the socket has, false if the peer closed the connection or it is broken.
+// the request is looked at after every 256 KiB, the rest waits in the socket
+static bool read_input(int fd, std::string &input) {
+#ifdef __linux__
+    char buffer[16 * 1024];
+    for (size_t i = 0; i < 16; i++) {
+        ssize_t n = recv(fd, buffer, sizeof(buffer), 0);
+        if (n == 0) {
+            return false;
+        }
+        if (n == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return errno == EAGAIN || errno == EWOULDBLOCK;
+        }
+        input.append(buffer, static_cast<size_t>(n));
+    }
+    return true;
+#else
+    (void) fd;
+    (void) input;
+    return false;
+#endif
+}
+
+void event_server::on_event(loop &l, connection &c, uint32_t events) {
+#ifdef __linux__
+    if (events & EPOLLERR) {
+        close_connection(l, c);
+        return;
+    }
+
+    if (!c.output.empty()) {
+        // the rest of a response
+        if (!write_output(c.fd, c.output)) {
+            close_connection(l, c);
+            return;
+        }
+        if (!c.output.empty()) {
+            rearm(l, c, EPOLLOUT);
+            return;
+        }
+        if (c.close_after) {
+            close_connection(l, c);
+            return;
+        }
+    } else if (!read_input(c.fd, c.input)) {
+        close_connection(l, c);
+        return;
+    }
+
+    c.last_active = std::chrono::steady_clock::now();
+    process_input(l, c);
+#else
+    (void) l;
+    (void) c;
+    (void) events;
+#endif
+}
+
+void event_server::process_input(loop &l, connection &c) {
+#ifdef __linux__
+    request_framing &framing = c.framing;
+    if (framing.header_size == 0) {
+        if (!read_framing(c)) {
+            spdlog::warn("invalid request, close connection, remote: {}", c.remote_ip);
+            close_connection(l, c);
+            return;
+        }
+        if (framing.header_size == 0) {
+            rearm(l, c, EPOLLIN);
+            return;
+        }
+        if (!framing.streamed && !framing.chunked && framing.content_length > max_body_size_) {
+            reject(l, c, 413);
+            return;
+        }
+    }
+
+    if (framing.streamed) {
+        {
+            std::lock_guard lock(l.mutex);
+            c.busy = true;
+        }
+        handlers_->submit([this, &l, &c]() {
+            handle_streamed(l, c);
+        });
+        return;
+    }
+
+    size_t size = 0;
+    if (framing.chunked) {
+        bool too_large = false;
+        size = parse_chunked(c.input, framing.header_size, framing.chunk_position, framing.trailers,
+                             max_body_size_, too_large);
+        if (too_large) {
+            reject(l, c, 413);
+            return;
+        }
+        if (size == std::string::npos) {
+            spdlog::warn("invalid chunked body, close connection, remote: {}", c.remote_ip);
+            close_connection(l, c);
+            return;
+        }
+    } else if (c.input.size() - framing.header_size >= framing.content_length) {
+        size = framing.header_size + framing.content_length;
+    }
+
+    if (size == 0) {
+        // the client waits for 100 Continue before it sends the body
+        if (framing.expect_continue && !c.continued) {
+            c.continued = true;
+            c.output = "HTTP/1.1 100 Continue\r\n\r\n";
+            if (!write_output(c.fd, c.output)) {
+                close_connection(l, c);
+                return;
+            }
+        }
+        rearm(l, c, c.output.empty() ? EPOLLIN : EPOLLOUT);
+        return;
+    }
+
+    {
+        std::lock_guard lock(l.mutex);
+        c.busy = true;
+    }
+    handlers_->submit([this, &l, &c, size]() {
+        handle(l, c, size);
+    });
+#else
+    (void) l;
+    (void) c;
+#endif
+}
+
+bool event_server::read_framing(connection &c) {
+    const std::string &input = c.input;
+    size_t header_end = input.find("\r\n\r\n");
+    if (header_end == std::string::npos) {
+        return input.size() <= max_header_size;
+    }
+    if (header_end > max_header_size) {
+        return false;
+    }
+
+    // "PUT /pdb/a.pdb/8F0F3D677778391600F4EB2301FFC7A5/1 HTTP/1.1"
+    size_t line_end = input.find("\r\n");
+    std::string_view request_line(input.data(), line_end);
+    size_t method_end = request_line.find(' ');
+    size_t target_end = method_end == std::string_view::npos
+                        ? std::string_view::npos : request_line.find(' ', method_end + 1);
+    if (target_end == std::string_view::npos) {
+        return false;
+    }
+    auto method = request_line.substr(0, method_end);
+    auto target = request_line.substr(method_end + 1, target_end - method_end - 1);
+
+    request_framing framing;
+    size_t position = line_end + 2;
+    while (position < header_end + 2) {
+        line_end = input.find("\r\n", position);
+        std::string_view line(input.data() + position, line_end - position);
+        position = line_end + 2;
+
+        size_t colon = line.find(':');
+        if (colon == std::string_view::npos) {
+            return false;
+        }
+        auto name = line.substr(0, colon);
+        auto value = trim(line.substr(colon + 1));
+        if (equals_ignore_case(name, "Content-Length")) {
+            std::string text(value);
+            char *end = nullptr;
+            framing.content_length = strtoull(text.c_str(), &end, 10);
+            if (text.empty() || *end != '\0') {
+                return false;
+            }
+        } else if (equals_ignore_case(name, "Transfer-Encoding")) {
+            framing.chunked = equals_ignore_case(value, "chunked");
+        } else if (equals_ignore_case(name, "Expect")) {
+            framing.expect_continue = equals_ignore_case(value, "100-continue");
+        }
+    }
+    framing.header_size = header_end + 4;
+    framing.chunk_position = framing.header_size;
+
+    if (!streamed_routes_.empty()) {
+        // matched like httplib does, on the decoded path
+        std::string path = httplib::detail::decode_url(
+                std::string(target.substr(0, target.find_first_of("?#"))), false);
+        for (const auto &[route_method, pattern]: streamed_routes_) {
+            if (method == route_method && std::regex_match(path, pattern)) {
+                framing.streamed = true;
+                break;
+            }
+        }
+    }
+    c.framing = framing;
+    return true;
+}
+
+void event_server::reject(loop &l, connection &c, int status) {
+#ifdef __linux__
+    spdlog::warn("reject request, status: {}, remote: {}", status, c.remote_ip);
+    c.output = "HTTP/1.1 " + std::to_string(status) + " " + httplib::detail::status_message(status) +
+               "\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+    c.close_after = true;
+    if (!write_output(c.fd, c.output) || c.output.empty()) {
+        close_connection(l, c);
+    } else {
+        rearm(l, c, EPOLLOUT);
+    }
+#else
+    (void) l;
+    (void) c;
+    (void) status;
+#endif
+}
+
+void event_server::handle(loop &l, connection &c, size_t size) {
+    bool continued = c.continued;
+    c.continued = false;
+
+    request_stream stream(c.input, size, c.output, c.remote_ip, c.remote_port, c.local_ip, c.local_port);
+    bool closed = false;
+    bool last = ++c.requests >= keep_alive_requests;
+    // the loop has sent 100 Continue already, httplib would send it again
+    auto setup = [continued](httplib::Request &req) {
+        if (continued) {
+            req.headers.erase("Expect");
+        }
+    };
+    if (!process_request(stream, last, closed, setup) || last) {
+        closed = true;
+    }
+    c.input.erase(0, size);
+    c.framing = request_framing();
+    c.close_after = closed;
+    c.last_active = std::chrono::steady_clock::now();
+
+    if (!write_output(c.fd, c.output)) {
+        close_connection(l, c);
+    } else if (!c.output.empty()) {
+        rearm(l, c, EPOLLOUT);
+    } else if (c.close_after) {
+        close_connection(l, c);
+    } else {
+        // a pipelined request may be waiting already
+        process_input(l, c);
+    }
+}
+
+void event_server::handle_streamed(loop &l, connection &c) {
+    auto to_ms = [](time_t sec, time_t usec) {
+        return static_cast<int>(sec * 1000 + usec / 1000);
+    };
+    socket_stream stream(c.fd, c.input, to_ms(read_timeout_sec_, read_timeout_usec_),
+                         to_ms(write_timeout_sec_, write_timeout_usec_),
+                         c.remote_ip, c.remote_port, c.local_ip, c.local_port);
+    // a handler may answer without reading the body (a rejected upload), what is left
+    // of it cannot be told from the next request, the connection is not used again
+    bool closed = false;
+    process_request(stream, true, closed, nullptr);
+    close_connection(l, c);
+}
+
+void event_server::rearm(loop &l, connection &c, uint32_t events) {
+#ifdef __linux__
+    epoll_event event{};
+    event.events = events | EPOLLONESHOT;
+    event.data.ptr = &c;
+    std::lock_guard lock(l.mutex);
+    c.busy = false;
+    epoll_ctl(l.epoll_fd, EPOLL_CTL_MOD, c.fd, &event);
+#else
+    (void) l;
+    (void) c;
+    (void) events;
+#endif
+}
+
+void event_server::close_connection(loop &l, connection &c) {
+#ifdef __linux__
+    // c is destroyed here
+    int fd = c.fd;
+    std::lock_guard lock(l.mutex);
+    l.connections.erase(fd);
+    close(fd);
+#else
+    (void) l;
+    (void) c;
+#endif
+}
+
+void event_server::close_idle(loop &l) {
+#ifdef __linux__
+    auto deadline = std::chrono::steady_clock::now() - idle_timeout_;
+    std::lock_guard lock(l.mutex);
+    for (auto it = l.connections.begin(); it != l.connections.end();) {
+        const connection &c = *it->second;
+        if (!c.busy && c.last_active < deadline) {
+            close(c.fd);
+            it = l.connections.erase(it);
+        } else {
+            ++it;
+        }
+    }
+#else
+    (void) l;
+#endif
+}
@@ -0,0 +1,131 @@
+#ifndef QUERY_PDB_SERVER_EVENT_SERVER_H
+#define QUERY_PDB_SERVER_EVENT_SERVER_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <regex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <httplib.h>
+#include "work_pool.h"
+
+// http front end for many mostly idle keep-alive connections (linux only).
+// a few threads wait on epoll for all connections, a complete request is handed to
+// the handler threads and answered with the routes and the exception handler
+// registered on the httplib::Server base, so every endpoint behaves as with
+// Server::listen. an idle connection costs no thread. request bodies are read
+// completely before the handler runs, except for the routes given to stream_body
+class event_server : public httplib::Server {
+public:
+    // loop_threads wait for socket events, handler_threads run the handlers.
+    // connections idle for idle_timeout are closed, larger bodies than max_body_size
+    // are rejected with 413 before they are read
+    event_server(size_t loop_threads, size_t handler_threads, std::chrono::seconds idle_timeout,
+                 size_t max_body_size);
+
+    ~event_server() override;
+
+    // the platform has epoll
+    static bool is_supported();
+
+    // serve until stop_events() is called, returns false if the address cannot
+    // be used or the platform has no epoll
+    bool listen_events(const std::string &ip, uint16_t port);
+
+    void stop_events();
+
+    // requests to a route registered with a ContentReader (an upload) whose path matches
+    // pattern are handed to a handler thread once their headers are in, it reads the
+    // body from the socket as the handler asks for it. the body is not limited by
+    // max_body_size and the connection is closed after the response
+    void stream_body(const std::string &method, const std::string &pattern);
+
+private:
+    // framing of the request being received on a connection
+    struct request_framing {
+        // request line and headers including the empty line, 0 while they are incomplete
+        size_t header_size = 0;
+        size_t content_length = 0;
+        bool chunked = false;
+        bool expect_continue = false;
+        bool streamed = false;
+        // the chunked body is complete up to this offset of the input, parsing goes on there
+        size_t chunk_position = 0;
+        bool trailers = false;
+    };
+
+    struct connection {
+        int fd;
+        std::string input;
+        request_framing framing;
+        // response bytes not written yet, the connection waits for EPOLLOUT meanwhile
+        std::string output;
+        std::string remote_ip;
+        int remote_port;
+        std::string local_ip;
+        int local_port;
+        std::chrono::steady_clock::time_point last_active;
+        // a handler owns the connection, guarded by the mutex of its loop
+        bool busy;
+        // close once output is written
+        bool close_after;
+        // 100 Continue was sent for the request being received
+        bool continued;
+        // requests answered, the connection is closed after keep_alive_requests
+        size_t requests;
+    };
+
+    // connections are armed one shot, only one thread (the loop or a handler) works
+    // on a connection at a time
+    struct loop {
+        int epoll_fd = -1;
+        std::thread thread;
+        std::mutex mutex;
+        std::unordered_map<int, std::unique_ptr<connection>> connections;
+    };
+
+    size_t handler_threads_;
+    std::chrono::seconds idle_timeout_;
+    size_t max_body_size_;
+    std::vector<std::pair<std::string, std::regex>> streamed_routes_;
+    // created by listen_events, a server listening with Server::listen needs no threads here
+    std::unique_ptr<work_pool> handlers_;
+    std::vector<std::unique_ptr<loop>> loops_;
+    int listen_fd_;
+    int stop_fd_;
+    std::atomic<bool> stopping_;
+
+    void run_loop(loop &l);
+
+    void accept_connections(loop &l);
+
+    void on_event(loop &l, connection &c, uint32_t events);
+
+    // dispatch the next complete request of c, or wait for more of it
+    void process_input(loop &l, connection &c);
+
+    // finds the size of the request and whether it is streamed once its headers are in,
+    // false if they are malformed or too large
+    bool read_framing(connection &c);
+
+    // answer with status and close, the request is not read any further
+    void reject(loop &l, connection &c, int status);
+
+    void handle(loop &l, connection &c, size_t size);
+
+    void handle_streamed(loop &l, connection &c);
+
+    void rearm(loop &l, connection &c, uint32_t events);
+
+    void close_connection(loop &l, connection &c);
+
+    void close_idle(loop &l);
+};
+
+#endif //QUERY_PDB_SERVER_EVENT_SERVER_H
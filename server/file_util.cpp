@@ -0,0 +1,149 @@
+#include <atomic>
+#include <random>
+#include <system_error>
+#include <spdlog/spdlog.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#endif
+#ifdef __linux__
+#include <sys/ioctl.h>
+#include <linux/fs.h>
+#endif
+#include "file_util.h"
+
+bool get_file_id(const std::filesystem::path &path, file_id &id) {
+#ifdef _WIN32
+    HANDLE file = CreateFileW(path.c_str(), 0,
+                              FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                              nullptr, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    BY_HANDLE_FILE_INFORMATION info;
+    bool success = GetFileInformationByHandle(file, &info);
+    CloseHandle(file);
+    if (!success) {
+        return false;
+    }
+    id.device = info.dwVolumeSerialNumber;
+    id.index = (static_cast<uint64_t>(info.nFileIndexHigh) << 32) | info.nFileIndexLow;
+    return true;
+#else
+    struct stat sb{};
+    if (stat(path.c_str(), &sb) == -1) {
+        return false;
+    }
+    id.device = static_cast<uint64_t>(sb.st_dev);
+    id.index = static_cast<uint64_t>(sb.st_ino);
+    return true;
+#endif
+}
+
+std::filesystem::path get_unique_tmp_path(const std::filesystem::path &path) {
+    // the process id and the random part keep other processes (e.g. query_pdb_ingest,
+    // forked workers sharing the tag) apart, the counter keeps threads of this process apart
+    static const uint32_t process_tag = std::random_device{}();
+    static std::atomic<uint64_t> counter{0};
+#ifdef _WIN32
+    auto process_id = static_cast<uint64_t>(GetCurrentProcessId());
+#else
+    auto process_id = static_cast<uint64_t>(getpid());
+#endif
+
+    auto tmp_path = path;
+    tmp_path += ".tmp" + std::to_string(process_tag) + "_" + std::to_string(process_id) + "_" +
+                std::to_string(counter++);
+    return tmp_path;
+}
+
+file_lock::file_lock(const std::filesystem::path &path)
+        : fd_(-1) {
+#ifndef _WIN32
+    fd_ = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd_ == -1) {
+        spdlog::warn("failed to open lock, path: {}", path.string());
+        return;
+    }
+    while (flock(fd_, LOCK_EX) == -1) {
+        if (errno != EINTR) {
+            spdlog::warn("failed to lock, path: {}", path.string());
+            break;
+        }
+    }
+#else
+    (void) path;
+#endif
+}
+
+file_lock::~file_lock() {
+#ifndef _WIN32
+    if (fd_ != -1) {
+        // closing the last descriptor releases the lock
+        close(fd_);
+    }
+#endif
+}
+
+static bool reflink_file(const std::filesystem::path &src, const std::filesystem::path &dst) {
+#if defined(__linux__) && defined(FICLONE)
+    int src_fd = open(src.c_str(), O_RDONLY);
+    if (src_fd == -1) {
+        return false;
+    }
+    int dst_fd = open(dst.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (dst_fd == -1) {
+        close(src_fd);
+        return false;
+    }
+    bool success = ioctl(dst_fd, FICLONE, src_fd) == 0;
+    close(dst_fd);
+    close(src_fd);
+    if (!success) {
+        std::error_code ec;
+        std::filesystem::remove(dst, ec);
+    }
+    return success;
+#else
+    (void) src;
+    (void) dst;
+    return false;
+#endif
+}
+
+bool place_file(const std::filesystem::path &src, const std::filesystem::path &dst) {
+    std::error_code ec;
+    std::filesystem::create_directories(dst.parent_path(), ec);
+    if (ec) {
+        spdlog::error("failed to create directory, path: {}, error: {}",
+                      dst.parent_path().string(), ec.message());
+        return false;
+    }
+
+    auto tmp_path = get_unique_tmp_path(dst);
+
+    std::filesystem::create_hard_link(src, tmp_path, ec);
+    if (ec && !reflink_file(src, tmp_path)) {
+        std::filesystem::copy_file(src, tmp_path,
+                                   std::filesystem::copy_options::overwrite_existing, ec);
+        if (ec) {
+            spdlog::error("failed to copy file, from: {}, to: {}, error: {}",
+                          src.string(), tmp_path.string(), ec.message());
+            std::filesystem::remove(tmp_path, ec);
+            return false;
+        }
+    }
+
+    std::filesystem::rename(tmp_path, dst, ec);
+    if (ec) {
+        spdlog::error("failed to rename file, from: {}, to: {}, error: {}",
+                      tmp_path.string(), dst.string(), ec.message());
+        std::filesystem::remove(tmp_path, ec);
+        return false;
+    }
+    return true;
+}
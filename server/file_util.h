@@ -0,0 +1,50 @@
+#ifndef QUERY_PDB_SERVER_FILE_UTIL_H
+#define QUERY_PDB_SERVER_FILE_UTIL_H
+
+#include <string>
+#include <cstdint>
+#include <filesystem>
+
+// identifies the file behind a path, hardlinks of one file share the same id
+struct file_id {
+    uint64_t device;
+    uint64_t index;
+
+    bool operator<(const file_id &other) const {
+        return device != other.device ? device < other.device : index < other.index;
+    }
+
+    bool operator==(const file_id &other) const {
+        return device == other.device && index == other.index;
+    }
+};
+
+bool get_file_id(const std::filesystem::path &path, file_id &id);
+
+// a name next to path that no other writer will pick
+std::filesystem::path get_unique_tmp_path(const std::filesystem::path &path);
+
+// an exclusive lock on an existing file or directory, shared with other processes
+// and held for the lifetime of the object. coordinates the server workers on one
+// download path (not on windows, where there is one process)
+class file_lock {
+public:
+    explicit file_lock(const std::filesystem::path &path);
+
+    ~file_lock();
+
+    file_lock(const file_lock &) = delete;
+
+    file_lock &operator=(const file_lock &) = delete;
+
+private:
+    int fd_;
+};
+
+// place a copy of src at dst without reading it through user space,
+// try hardlink first, then reflink (linux only), then a kernel side copy.
+// the file is first created next to dst and renamed, so dst never
+// appears half written
+bool place_file(const std::filesystem::path &src, const std::filesystem::path &dst);
+
+#endif //QUERY_PDB_SERVER_FILE_UTIL_H
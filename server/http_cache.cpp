@@ -0,0 +1,130 @@
+#include <algorithm>
+#include <cctype>
+#include <memory>
+#include <openssl/evp.h>
+#include "http_cache.h"
+
+// a year, the longest max-age caches are required to honor
+static const char *cache_control = "public, max-age=31536000, immutable";
+
+// bump when the response format changes, cached responses become stale
+static const char *etag_version = "1";
+
+// every byte but the unreserved characters is escaped, so equal
+// queries always produce an equal url
+static std::string percent_encode(const std::string &s) {
+    static const char hex[] = "0123456789ABCDEF";
+    std::string result;
+    for (char c: s) {
+        auto u = static_cast<unsigned char>(c);
+        if (isalnum(u) || c == '-' || c == '.' || c == '_' || c == '~') {
+            result.push_back(c);
+        } else {
+            result.push_back('%');
+            result.push_back(hex[u >> 4]);
+            result.push_back(hex[u & 0xf]);
+        }
+    }
+    return result;
+}
+
+query_params get_canonical_params(const httplib::Request &req) {
+    query_params params(req.params.begin(), req.params.end());
+    std::sort(params.begin(), params.end());
+    params.erase(std::unique(params.begin(), params.end()), params.end());
+    return params;
+}
+
+std::string get_canonical_target(const std::string &endpoint, const std::string &name,
+                                 const std::string &guid, uint32_t age, const query_params &params) {
+    std::string upper_guid = guid;
+    std::transform(upper_guid.begin(), upper_guid.end(), upper_guid.begin(), toupper);
+
+    std::string target = "/" + endpoint + "/" + percent_encode(name) + "/" + upper_guid + "/" +
+                         std::to_string(age);
+    for (size_t i = 0; i < params.size(); i++) {
+        target += i == 0 ? '?' : '&';
+        target += percent_encode(params[i].first) + "=" + percent_encode(params[i].second);
+    }
+    return target;
+}
+
+std::string get_etag(const std::string &canonical_target, response_encoding encoding) {
+    const std::string input = std::string(etag_version) + "\n" + get_content_type(encoding) +
+                              "\n" + canonical_target;
+
+    unsigned char digest[EVP_MAX_MD_SIZE];
+    unsigned int digest_size = 0;
+    if (EVP_Digest(input.data(), input.size(), digest, &digest_size, EVP_sha256(), nullptr) != 1) {
+        throw std::runtime_error("failed to hash etag");
+    }
+
+    // 128 bits are plenty to tell responses apart
+    static const char hex[] = "0123456789abcdef";
+    std::string etag = "\"";
+    for (unsigned int i = 0; i < std::min(digest_size, 16u); i++) {
+        etag.push_back(hex[digest[i] >> 4]);
+        etag.push_back(hex[digest[i] & 0xf]);
+    }
+    etag.push_back('"');
+    return etag;
+}
+
+// a compressed response is another representation and gets its own etag,
+// e.g. "0123...-gzip"
+static std::string get_coded_etag(const std::string &etag, const std::string &coding) {
+    return etag.substr(0, etag.size() - 1) + "-" + coding + "\"";
+}
+
+// the etag of the If-None-Match list that matches, empty if none does
+static std::string match_etag(const std::string &if_none_match, const std::string &etag) {
+    // a comma separated list, weak comparison as required for If-None-Match
+    size_t pos = 0;
+    while (pos < if_none_match.size()) {
+        size_t end = if_none_match.find(',', pos);
+        if (end == std::string::npos) {
+            end = if_none_match.size();
+        }
+        std::string candidate = if_none_match.substr(pos, end - pos);
+        candidate.erase(0, candidate.find_first_not_of(" \t"));
+        candidate.erase(candidate.find_last_not_of(" \t") + 1);
+        if (candidate.rfind("W/", 0) == 0) {
+            candidate.erase(0, 2);
+        }
+        if (candidate == "*") {
+            return etag;
+        }
+        if (candidate == etag ||
+            candidate == get_coded_etag(etag, "gzip") ||
+            candidate == get_coded_etag(etag, "deflate")) {
+            return candidate;
+        }
+        pos = end + 1;
+    }
+    return {};
+}
+
+void set_immutable(httplib::Response &res) {
+    res.set_header("Cache-Control", cache_control);
+}
+
+void set_cacheable(httplib::Response &res, const std::string &etag) {
+    if (res.has_header("Content-Encoding")) {
+        res.set_header("ETag", get_coded_etag(etag, res.get_header_value("Content-Encoding")));
+    } else {
+        res.set_header("ETag", etag);
+    }
+    set_immutable(res);
+}
+
+bool check_not_modified(const httplib::Request &req, httplib::Response &res, const std::string &etag) {
+    std::string matched = match_etag(req.get_header_value("If-None-Match"), etag);
+    if (matched.empty()) {
+        return false;
+    }
+    res.set_header("ETag", matched);
+    set_immutable(res);
+    res.set_header("Vary", "Accept, Accept-Encoding");
+    res.status = 304;
+    return true;
+}
@@ -0,0 +1,35 @@
+#ifndef QUERY_PDB_SERVER_HTTP_CACHE_H
+#define QUERY_PDB_SERVER_HTTP_CACHE_H
+
+#include <string>
+#include <utility>
+#include <vector>
+#include <httplib.h>
+#include "response_encoding.h"
+
+// support for the GET endpoints, a pdb identified by name, guid and age
+// never changes, so their responses can be cached forever by any http cache
+
+using query_params = std::vector<std::pair<std::string, std::string>>;
+
+// the query parameters sorted by key and value, duplicates removed
+query_params get_canonical_params(const httplib::Request &req);
+
+// the only url a given query is served from, e.g.
+// /symbol/ntdll.pdb/ABCDEF.../1?name=A&name=B
+std::string get_canonical_target(const std::string &endpoint, const std::string &name,
+                                 const std::string &guid, uint32_t age, const query_params &params);
+
+// strong etag of a response, derived from the canonical target and the encoding
+std::string get_etag(const std::string &canonical_target, response_encoding encoding);
+
+// mark the response as cacheable forever
+void set_immutable(httplib::Response &res);
+
+// set ETag and Cache-Control of a successful response, errors must not be cached
+void set_cacheable(httplib::Response &res, const std::string &etag);
+
+// returns true if the client copy is current and the response was turned into a 304
+bool check_not_modified(const httplib::Request &req, httplib::Response &res, const std::string &etag);
+
+#endif //QUERY_PDB_SERVER_HTTP_CACHE_H
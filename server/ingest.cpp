@@ -0,0 +1,116 @@
+#include <atomic>
+#include <algorithm>
+#include <cctype>
+#include <thread>
+#include <vector>
+#include <cxxopts.hpp>
+#include <spdlog/spdlog.h>
+#include "downloader.h"
+#include "object_store.h"
+#include "pdb_parser.h"
+
+// walk a symbol directory tree (SymStore or any other layout) and place
+// every valid PDB into the download path layout used by query_pdb_server
+
+static bool is_pdb_file(const std::filesystem::directory_entry &entry) {
+    std::error_code ec;
+    if (!entry.is_regular_file(ec)) {
+        return false;
+    }
+    std::string extension = entry.path().extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(), tolower);
+    return extension == ".pdb";
+}
+
+int main(int argc, char *argv[]) {
+    cxxopts::Options option_parser("query-pdb-ingest", "pdb bulk ingest tool");
+    option_parser.add_options()
+            ("source", "symbol directory to ingest", cxxopts::value<std::string>())
+            ("path", "download path of the server", cxxopts::value<std::string>()->default_value("save"))
+            ("threads", "worker thread count, 0 means hardware concurrency",
+                    cxxopts::value<uint32_t>()->default_value("0"))
+            ("h,help", "print help");
+
+    auto parse_result = option_parser.parse(argc, argv);
+
+    if (parse_result.count("help") || !parse_result.count("source")) {
+        std::cout << option_parser.help() << std::endl;
+        return parse_result.count("help") ? 0 : 1;
+    }
+
+    const auto source = parse_result["source"].as<std::string>();
+    const auto download_path = parse_result["path"].as<std::string>();
+    auto thread_count = parse_result["threads"].as<uint32_t>();
+    if (thread_count == 0) {
+        thread_count = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    // collect first, so the workers only deal with pdb files
+    std::vector<std::filesystem::path> files;
+    std::error_code ec;
+    for (auto it = std::filesystem::recursive_directory_iterator(source, ec);
+         !ec && it != std::filesystem::recursive_directory_iterator(); it.increment(ec)) {
+        if (is_pdb_file(*it)) {
+            files.push_back(it->path());
+        }
+    }
+    if (ec) {
+        spdlog::error("failed to walk source directory, path: {}, error: {}", source, ec.message());
+        return 1;
+    }
+    spdlog::info("ingest start, source: {}, path: {}, files: {}, threads: {}",
+                 source, download_path, files.size(), thread_count);
+
+    object_store objects(download_path);
+    std::atomic<size_t> next{0};
+    std::atomic<size_t> ingested{0};
+    std::atomic<size_t> skipped{0};
+    std::atomic<size_t> failed{0};
+
+    auto worker = [&]() {
+        for (size_t i = next++; i < files.size(); i = next++) {
+            const auto &file = files[i];
+            const std::string name = file.filename().string();
+
+            try {
+                pdb_info info = pdb_parser(file.string()).get_info();
+                if (!downloader::is_valid_pdb(name, file)) {
+                    spdlog::warn("invalid pdb, path: {}", file.string());
+                    failed++;
+                    continue;
+                }
+
+                std::string relative_path =
+                        downloader::get_relative_path_str(name, info.guid, info.age);
+                auto target = std::filesystem::path(download_path).append(relative_path);
+                std::error_code exists_ec;
+                if (std::filesystem::exists(target, exists_ec)) {
+                    skipped++;
+                    continue;
+                }
+
+                if (!objects.insert(file, target, false)) {
+                    failed++;
+                    continue;
+                }
+                spdlog::info("ingest pdb, path: {}", relative_path);
+                ingested++;
+            } catch (std::exception &e) {
+                spdlog::warn("invalid pdb, path: {}, error: {}", file.string(), e.what());
+                failed++;
+            }
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (uint32_t i = 0; i < thread_count; i++) {
+        workers.emplace_back(worker);
+    }
+    for (auto &t: workers) {
+        t.join();
+    }
+
+    spdlog::info("ingest done, ingested: {}, skipped: {}, failed: {}",
+                 ingested.load(), skipped.load(), failed.load());
+    return failed ? 2 : 0;
+}
@@ -1,47 +1,319 @@
+#include <algorithm>
+#include <cctype>
+#include <condition_variable>
+#include <deque>
+#include <filesystem>
+#include <limits>
+#include <memory_resource>
+#include <mutex>
+#include <optional>
+#include <thread>
 #include <utility>
-#include <set>
+#include <vector>
 #define CPPHTTPLIB_OPENSSL_SUPPORT
 #include <httplib.h>
 #include <cxxopts.hpp>
-#include <nlohmann/json.hpp>
 #include <spdlog/spdlog.h>
 #include <spdlog/sinks/daily_file_sink.h>
+#include "admission_control.h"
+#include "compression.h"
 #include "downloader.h"
+#include "event_server.h"
+#include "http_cache.h"
+#include "memory_pressure.h"
+#include "pdb_cache.h"
 #include "pdb_parser.h"
+#include "request_arena.h"
+#include "request_reader.h"
+#include "request_coalescer.h"
+#include "response_cache.h"
+#include "response_encoding.h"
+#include "shm_server.h"
+#include "work_pool.h"
+#include "worker_processes.h"
 
-int main(int argc, char *argv[]) {
-    cxxopts::Options option_parser("query-pdb", "pdb query server");
-    option_parser.add_options()
-            ("ip", "ip address", cxxopts::value<std::string>()->default_value("0.0.0.0"))
-            ("port", "port", cxxopts::value<uint16_t>()->default_value("8080"))
-            ("path", "download path", cxxopts::value<std::string>()->default_value("save"))
-            ("server", "download server", cxxopts::value<std::string>()->default_value(
-                    "https://msdl.microsoft.com/download/symbols/"))
-            ("h,help", "print help");
+// constant time comparison of the bearer token
+static bool is_authorized(const httplib::Request &req, const std::string &token) {
+    const std::string expected = "Bearer " + token;
+    const std::string actual = req.get_header_value("Authorization");
+    if (actual.size() != expected.size()) {
+        return false;
+    }
 
-    auto parse_result = option_parser.parse(argc, argv);
+    unsigned char diff = 0;
+    for (size_t i = 0; i < expected.size(); i++) {
+        diff |= static_cast<unsigned char>(actual[i] ^ expected[i]);
+    }
+    return diff == 0;
+}
 
-    if (parse_result.count("help")) {
-        std::cout << option_parser.help() << std::endl;
-        return 0;
+// what answering a request needs, the http threads only hand work to the pools and wait
+struct query_context {
+    downloader &storage;
+    pdb_cache &parsers;
+    admission_control &admission;
+    // parsing, querying and serializing
+    work_pool &cpu_pool;
+    // downloads, which may take minutes
+    work_pool &io_pool;
+};
+
+// the priority a request asks for with its X-Priority header: interactive, batch or prefetch
+static work_priority get_priority(const httplib::Request &req, work_priority fallback) {
+    auto value = req.get_header_value("X-Priority");
+    if (value.empty()) {
+        return fallback;
+    }
+    if (value == "interactive") {
+        return work_priority::interactive;
+    }
+    if (value == "batch") {
+        return work_priority::batch;
+    }
+    if (value == "prefetch") {
+        return work_priority::prefetch;
     }
+    throw std::runtime_error("invalid priority: " + value);
+}
 
-    const auto ip = parse_result["ip"].as<std::string>();
-    const auto port = parse_result["port"].as<uint16_t>();
-    const auto download_path = parse_result["path"].as<std::string>();
-    const auto download_server = parse_result["server"].as<std::string>();
+// find the pdb of a request, a pdb that is not in the download path yet is
+// downloaded on the io pool. throws if the download fails
+static pdb_location locate_pdb(query_context &context, const pdb_request &request) {
+    if (!request.error.empty()) {
+        throw std::runtime_error(request.error);
+    }
 
-    downloader storage(download_path, download_server);
-    if (!storage.valid()) {
-        spdlog::error("exit due to downloader invalid");
-        return 1;
+    pdb_location location;
+    if (context.storage.find(request.name, request.guid, request.age, location)) {
+        return location;
+    }
+    auto slot = context.admission.admit(admission_control::work::download);
+    bool success = context.io_pool.run([&context, &request, &location]() {
+        return context.storage.download(request.name, request.guid, request.age, location);
+    }, request.priority);
+    if (!success) {
+        throw std::runtime_error("download failed");
+    }
+    return location;
+}
+
+// parse the pdb of a request. a file that changed in the download path since it was
+// indexed is found or downloaded again, on the calling thread as this is rare
+static pdb_cache::pin get_parser(query_context &context, const pdb_request &request, pdb_location &location) {
+    try {
+        return context.parsers.get(location);
+    } catch (std::exception &e) {
+        if (!context.storage.recover(request.name, request.guid, request.age, location)) {
+            throw;
+        }
     }
+    return context.parsers.get(location);
+}
+
+// call answer with the parser of the request on the cpu pool, throws overloaded_error
+// if the request, its download or its parse is beyond the admission limits
+template<typename F>
+static void answer_with_parser(query_context &context, const pdb_request &request, F answer) {
+    auto slot = context.admission.admit(admission_control::work::request);
+    auto location = locate_pdb(context, request);
 
-    httplib::Server server;
-    server.set_exception_handler([](const auto &req, auto &res, std::exception_ptr ep) {
+    auto parser = context.parsers.find(location);
+    std::optional<admission_control::slot> parse_slot;
+    if (!parser) {
+        parse_slot.emplace(context.admission.admit(admission_control::work::parse));
+    }
+    context.cpu_pool.run([&]() {
+        if (!parser) {
+            parser = get_parser(context, request, location);
+        }
+        answer(*parser);
+    }, request.priority);
+}
+
+static void answer_symbol(query_context &context, const httplib::Request &req,
+                          httplib::Response &res, const pdb_request &request) {
+    answer_with_parser(context, request, [&](const pdb_parser &parser) {
+        set_symbol_result(req, res, request, parser.get_symbols(request.query.symbols, request.memory));
+    });
+}
+
+static void answer_struct(query_context &context, const httplib::Request &req,
+                          httplib::Response &res, const pdb_request &request) {
+    answer_with_parser(context, request, [&](const pdb_parser &parser) {
+        set_struct_result(req, res, request, parser.get_struct(request.query.structs, request.memory));
+    });
+}
+
+static void answer_enum(query_context &context, const httplib::Request &req,
+                        httplib::Response &res, const pdb_request &request) {
+    answer_with_parser(context, request, [&](const pdb_parser &parser) {
+        set_enum_result(req, res, request, parser.get_enum(request.query.enums, request.memory));
+    });
+}
+
+static void answer_query(query_context &context, const httplib::Request &req,
+                         httplib::Response &res, const pdb_request &request) {
+    answer_with_parser(context, request, [&](const pdb_parser &parser) {
+        set_query_result(req, res, request, parser.query(request.query, request.memory));
+    });
+}
+
+// turn a GET request into the matching POST request and its etag, returns false
+// if the response is already complete (redirect to the canonical url or 304)
+static bool get_cacheable_request(const std::string &endpoint, const httplib::Request &req,
+                                  httplib::Response &res, pdb_request &request,
+                                  std::string &etag) {
+    auto name = req.matches[1].str();
+    auto guid = req.matches[2].str();
+    auto age = static_cast<uint32_t>(std::stoul(req.matches[3].str()));
+    auto params = get_canonical_params(req);
+
+    // every query has exactly one url, so caches in front of us see one entry per query
+    auto target = get_canonical_target(endpoint, name, guid, age, params);
+    if (req.target != target) {
+        set_immutable(res);
+        res.set_redirect(target, 301);
+        return false;
+    }
+    etag = get_etag(target, negotiate_encoding(req));
+    if (check_not_modified(req, res, etag)) {
+        return false;
+    }
+
+    request.name = name;
+    request.guid = guid;
+    request.age = age;
+
+    size_t capacity = 0;
+    for (const auto &[key, value]: params) {
+        capacity += key.size() + value.size() + 2;
+    }
+    name_buffer names(capacity, request.memory);
+
+    if (endpoint == "symbol") {
+        request.has_symbols = true;
+        for (const auto &[key, value]: params) {
+            if (key != "name") {
+                throw std::runtime_error("unknown parameter: " + key);
+            }
+            request.symbols.push_back(names.add(value));
+        }
+    } else {
+        request.has_structs = endpoint == "struct";
+        request.has_enums = endpoint == "enum";
+        type_list &types = request.has_structs ? request.structs : request.enums;
+        for (const auto &[key, value]: params) {
+            auto type = names.add(key);
+            types.types.push_back(type);
+            types.members.emplace_back(type, names.add(value));
+        }
+    }
+    index_request(request);
+    return true;
+}
+
+// names are length prefixed, no name can be mistaken for a separator
+static void append_name(std::string &key, std::string_view name) {
+    key += std::to_string(name.size());
+    key += ':';
+    key += name;
+}
+
+template<typename Names>
+static void append_names(std::string &key, const Names &names) {
+    key += std::to_string(names.size());
+    key += '#';
+    for (std::string_view name: names) {
+        append_name(key, name);
+    }
+}
+
+static void append_members(std::string &key, const member_set &members) {
+    key += std::to_string(members.type_count());
+    key += '#';
+    for (const auto &entry: members) {
+        append_name(key, entry.type);
+        append_names(key, entry.members);
+    }
+}
+
+static void append_ordered_members(std::string &key, const type_list &members) {
+    key += std::to_string(members.members.size());
+    key += '#';
+    for (const auto &[type, name]: members.members) {
+        append_name(key, type);
+        append_name(key, name);
+    }
+}
+
+// identifies a response completely: endpoint, pdb, the query with names sorted and
+// deduplicated, the encoding and the content coding. wire responses follow the
+// request order, their query is kept as it is
+static std::string get_response_key(const std::string &endpoint, const httplib::Request &req,
+                                    const pdb_request &request) {
+    auto guid = request.guid;
+    std::transform(guid.begin(), guid.end(), guid.begin(), toupper);
+    response_encoding encoding = negotiate_encoding(req);
+
+    std::string key = endpoint + "\n" + request.name + "\n" + guid + "\n" +
+                      std::to_string(request.age) + "\n";
+    if (encoding == response_encoding::wire && endpoint != "query") {
+        append_names(key, request.symbols);
+        append_ordered_members(key, request.structs);
+        append_ordered_members(key, request.enums);
+    } else {
+        if (request.has_symbols) {
+            key += "symbol";
+            append_names(key, request.query.symbols);
+        }
+        if (request.has_structs) {
+            key += "struct";
+            append_members(key, request.query.structs);
+        }
+        if (request.has_enums) {
+            key += "enum";
+            append_members(key, request.query.enums);
+        }
+    }
+
+    return key + "\n" + get_content_type(encoding) + "\n" +
+           get_coding_name(negotiate_coding(req, std::numeric_limits<size_t>::max()));
+}
+
+// answer from the response cache, or from an identical request in flight,
+// or call answer and keep what it responded
+template<typename F>
+static void answer_cached(response_cache &responses, request_coalescer &inflight,
+                          const std::string &key, httplib::Response &res, F answer) {
+    auto response = responses.find(key);
+    if (!response) {
+        response = inflight.run(key, [&]() {
+            httplib::Response computed;
+            answer(computed);
+            auto result = std::make_shared<const stored_response>(computed);
+            responses.insert(key, result);
+            return result;
+        });
+    }
+    response->apply(res);
+}
+
+// PUT /pdb/<name>/<guid>/<age>, the body is read as the upload handler asks for it
+static const char *const upload_pattern = R"(/pdb/([^/]+)/([0-9A-Fa-f]{32})/(\d+))";
+
+// the routes and the error handling of every listener
+static void add_routes(httplib::Server &server, query_context &context, response_cache &responses,
+                       request_coalescer &inflight, const std::string &upload_token) {
+    server.set_exception_handler([&context](const auto &req, auto &res, std::exception_ptr ep) {
         std::string content;
         try {
             std::rethrow_exception(ep);
+        } catch (overloaded_error &e) {
+            // rejected before doing any work, the client may try again soon
+            res.set_content(e.what(), "plain/text");
+            res.set_header("Retry-After", std::to_string(context.admission.retry_after()));
+            res.status = 503;
+            return;
         } catch (std::exception &e) {
             content = e.what();
         } catch (...) {
@@ -53,6 +325,15 @@ int main(int argc, char *argv[]) {
         spdlog::error("exception: {}", content);
     });
 
+    // the response is JSON unless the Accept header asks for
+    // application/msgpack or application/cbor (see response_encoding.h),
+    // or application/x-qpdb-wire for fixed layout records in request order
+    // (see client/qpdb_wire.h)
+
+    // the X-Priority header (interactive, batch or prefetch) orders the work of a
+    // request on the parse and download threads, /batch is batch work by default
+    // and every other endpoint interactive
+
     // example:
     // {
     //     "name": "ntdll.pdb",
@@ -64,24 +345,16 @@ int main(int argc, char *argv[]) {
     //         ...
     //     ]
     // }
-    server.Post("/symbol", [&storage](const httplib::Request &req, httplib::Response &res) {
+    server.Post("/symbol", [&context, &responses, &inflight](
+            const httplib::Request &req, httplib::Response &res) {
         spdlog::info("symbol request: {}", req.body);
-        auto body = nlohmann::json::parse(req.body);
-        auto name = body["name"].get<std::string>();
-        auto guid = body["guid"].get<std::string>();
-        auto age = body["age"].get<uint32_t>();
-        auto query = body["query"].get<std::set<std::string>>();
-
-        // download pdb
-        if (!storage.download(name, guid, age)) {
-            throw std::runtime_error("download failed");
-        }
-
-        // parse pdb
-        pdb_parser parser(storage.get_path(name, guid, age).string());
-        nlohmann::json result = parser.get_symbols(query);
-
-        res.set_content(result.dump(), "application/json");
+        request_arena arena;
+        auto request = read_request(req.body, query_part::symbols, &arena);
+        request.priority = get_priority(req, work_priority::interactive);
+        auto key = get_response_key("symbol", req, request);
+        answer_cached(responses, inflight, key, res, [&](httplib::Response &out) {
+            answer_symbol(context, req, out, request);
+        });
     });
 
     // example:
@@ -95,33 +368,16 @@ int main(int argc, char *argv[]) {
     //         ...
     //     }
     // }
-    server.Post("/struct", [&storage](const httplib::Request &req, httplib::Response &res) {
+    server.Post("/struct", [&context, &responses, &inflight](
+            const httplib::Request &req, httplib::Response &res) {
         spdlog::info("struct request: {}", req.body);
-        auto body = nlohmann::json::parse(req.body);
-        auto name = body["name"].get<std::string>();
-        auto guid = body["guid"].get<std::string>();
-        auto age = body["age"].get<uint32_t>();
-        auto query = body["query"].get<std::map<std::string, std::set<std::string>>>();
-
-        // download pdb
-        if (!storage.download(name, guid, age)) {
-            throw std::runtime_error("download failed");
-        }
-
-        // parse pdb
-        pdb_parser parser(storage.get_path(name, guid, age).string());
-        std::map<std::string, std::map<std::string, field_info>> result =
-                parser.get_struct(query);
-
-        std::map<std::string, std::map<std::string, std::map<std::string, int64_t>>> translate;
-        for (const auto &[struct_name, fields]: result) {
-            translate[struct_name] = {};
-            for (const auto &[field_name, field]: fields) {
-                translate[struct_name][field_name] = field.to_map();
-            }
-        }
-
-        res.set_content(nlohmann::json(translate).dump(), "application/json");
+        request_arena arena;
+        auto request = read_request(req.body, query_part::structs, &arena);
+        request.priority = get_priority(req, work_priority::interactive);
+        auto key = get_response_key("struct", req, request);
+        answer_cached(responses, inflight, key, res, [&](httplib::Response &out) {
+            answer_struct(context, req, out, request);
+        });
     });
 
     // example:
@@ -135,26 +391,458 @@ int main(int argc, char *argv[]) {
     //         ...
     //     }
     // }
-    server.Post("/enum", [&storage](const httplib::Request &req, httplib::Response &res) {
+    server.Post("/enum", [&context, &responses, &inflight](
+            const httplib::Request &req, httplib::Response &res) {
         spdlog::info("enum request: {}", req.body);
-        auto body = nlohmann::json::parse(req.body);
-        auto name = body["name"].get<std::string>();
-        auto guid = body["guid"].get<std::string>();
-        auto age = body["age"].get<uint32_t>();
-        auto query = body["query"].get<std::map<std::string, std::set<std::string>>>();
+        request_arena arena;
+        auto request = read_request(req.body, query_part::enums, &arena);
+        request.priority = get_priority(req, work_priority::interactive);
+        auto key = get_response_key("enum", req, request);
+        answer_cached(responses, inflight, key, res, [&](httplib::Response &out) {
+            answer_enum(context, req, out, request);
+        });
+    });
+
+    // cacheable GET variants of /symbol, /struct and /enum, the pdb is part of the
+    // path and every requested name is a parameter:
+    // GET /symbol/ntdll.pdb/ABCDEF.../1?name=Name1&name=Name2
+    // GET /struct/ntdll.pdb/ABCDEF.../1?struct1=field1&struct1=field2&struct2=field4
+    // GET /enum/ntdll.pdb/ABCDEF.../1?enum1=name1&enum1=name2
+    // responses are immutable and carry an ETag, If-None-Match is answered with 304
+    server.Get(R"(/symbol/([^/]+)/([0-9A-Fa-f]{32})/(\d+))",
+               [&context, &responses, &inflight](
+                       const httplib::Request &req, httplib::Response &res) {
+        spdlog::info("symbol request: {}", req.target);
+        request_arena arena;
+        pdb_request request(&arena);
+        request.priority = get_priority(req, work_priority::interactive);
+        std::string etag;
+        if (get_cacheable_request("symbol", req, res, request, etag)) {
+            auto key = get_response_key("symbol", req, request);
+            answer_cached(responses, inflight, key, res, [&](httplib::Response &out) {
+                answer_symbol(context, req, out, request);
+            });
+            set_cacheable(res, etag);
+        }
+    });
 
-        // download pdb
-        if (!storage.download(name, guid, age)) {
-            throw std::runtime_error("download failed");
+    server.Get(R"(/struct/([^/]+)/([0-9A-Fa-f]{32})/(\d+))",
+               [&context, &responses, &inflight](
+                       const httplib::Request &req, httplib::Response &res) {
+        spdlog::info("struct request: {}", req.target);
+        request_arena arena;
+        pdb_request request(&arena);
+        request.priority = get_priority(req, work_priority::interactive);
+        std::string etag;
+        if (get_cacheable_request("struct", req, res, request, etag)) {
+            auto key = get_response_key("struct", req, request);
+            answer_cached(responses, inflight, key, res, [&](httplib::Response &out) {
+                answer_struct(context, req, out, request);
+            });
+            set_cacheable(res, etag);
         }
+    });
 
-        // parse pdb
-        pdb_parser parser(storage.get_path(name, guid, age).string());
-        nlohmann::json result = parser.get_enum(query);
+    server.Get(R"(/enum/([^/]+)/([0-9A-Fa-f]{32})/(\d+))",
+               [&context, &responses, &inflight](
+                       const httplib::Request &req, httplib::Response &res) {
+        spdlog::info("enum request: {}", req.target);
+        request_arena arena;
+        pdb_request request(&arena);
+        request.priority = get_priority(req, work_priority::interactive);
+        std::string etag;
+        if (get_cacheable_request("enum", req, res, request, etag)) {
+            auto key = get_response_key("enum", req, request);
+            answer_cached(responses, inflight, key, res, [&](httplib::Response &out) {
+                answer_enum(context, req, out, request);
+            });
+            set_cacheable(res, etag);
+        }
+    });
 
-        res.set_content(result.dump(), "application/json");
+    // symbols, structs and enums in one request, every part is optional
+    // and the pdb is opened and walked once for all of them
+    // example:
+    // {
+    //     "name": "ntdll.pdb",
+    //     "guid": "ABCDEF...",
+    //     "age": 1
+    //     "symbol": ["Name1", "Name2", ...],
+    //     "struct": {"struct1": ["field1", "field2"], ...},
+    //     "enum": {"enum1": ["name1", "name2"], ...}
+    // }
+    // the response has the same keys, each holding what /symbol, /struct or /enum returns
+    server.Post("/query", [&context, &responses, &inflight](
+            const httplib::Request &req, httplib::Response &res) {
+        spdlog::info("query request: {}", req.body);
+        request_arena arena;
+        auto request = read_query_request(req.body, &arena);
+        request.priority = get_priority(req, work_priority::interactive);
+        auto key = get_response_key("query", req, request);
+        answer_cached(responses, inflight, key, res, [&](httplib::Response &out) {
+            answer_query(context, req, out, request);
+        });
     });
 
-    server.listen(ip, port);
-    return 0;
+    // several /query bodies at once, downloaded and resolved in parallel on the batch pool
+    // example:
+    // [
+    //     {"name": "ntkrnlmp.pdb", "guid": "ABCDEF...", "age": 1, "symbol": [...], ...},
+    //     {"name": "ntdll.pdb", "guid": "ABCDEF...", "age": 1, "struct": {...}, ...},
+    //     ...
+    // ]
+    // the response is an array in the same order, a pdb that cannot be resolved
+    // gets {"error": "..."} instead of failing the whole batch
+    server.Post("/batch", [&context](const httplib::Request &req, httplib::Response &res) {
+        spdlog::info("batch request: {}", req.body);
+        request_arena arena;
+        auto requests = read_batch_request(req.body, &arena);
+        auto priority = get_priority(req, work_priority::batch);
+        auto slot = context.admission.admit(admission_control::work::request);
+
+        // the entries are resolved on several threads, each one gets its own arena
+        std::deque<std::pmr::monotonic_buffer_resource> entry_memory(requests.size());
+        std::vector<std::optional<pdb_query_result>> results(requests.size());
+        std::vector<std::string> errors(requests.size());
+        std::mutex mutex;
+        std::condition_variable done;
+        size_t remaining = requests.size();
+
+        // every entry writes only its own slots, emplace keeps the result
+        // in the memory of the entry
+        auto finish = [&](size_t i, const char *error) {
+            if (error) {
+                spdlog::error("batch query failed, index: {}, error: {}", i, error);
+                errors[i] = error;
+            }
+            std::lock_guard lock(mutex);
+            if (--remaining == 0) {
+                done.notify_one();
+            }
+        };
+        auto resolve = [&](size_t i, pdb_location location) {
+            try {
+                auto parser = get_parser(context, requests[i], location);
+                results[i].emplace(parser->query(requests[i].query, &entry_memory[i]));
+            } catch (std::exception &e) {
+                finish(i, e.what());
+                return;
+            }
+            finish(i, nullptr);
+        };
+
+        // entries beyond the download or parse limits get an error, the others are resolved
+        using shared_slot = std::shared_ptr<admission_control::slot>;
+        auto admit = [&context](admission_control::work kind) {
+            return std::make_shared<admission_control::slot>(context.admission.admit(kind));
+        };
+        auto queue_parse = [&](size_t i, const pdb_location &location) {
+            shared_slot parse_slot;
+            if (!context.parsers.find(location)) {
+                try {
+                    parse_slot = admit(admission_control::work::parse);
+                } catch (overloaded_error &e) {
+                    finish(i, e.what());
+                    return;
+                }
+            }
+            context.cpu_pool.submit([&resolve, i, location, parse_slot]() {
+                resolve(i, location);
+            }, priority);
+        };
+
+        // present pdb files go straight to the cpu pool, the others are downloaded
+        // on the io pool first, a slow download holds up no parsing thread
+        for (size_t i = 0; i < requests.size(); i++) {
+            const pdb_request &request = requests[i];
+            pdb_location location;
+            shared_slot download_slot;
+            if (!request.error.empty()) {
+                finish(i, request.error.c_str());
+            } else if (context.storage.find(request.name, request.guid, request.age, location)) {
+                queue_parse(i, location);
+            } else {
+                try {
+                    download_slot = admit(admission_control::work::download);
+                } catch (overloaded_error &e) {
+                    finish(i, e.what());
+                    continue;
+                }
+                context.io_pool.submit([&context, &finish, &queue_parse, &request, i, download_slot]() mutable {
+                    pdb_location downloaded;
+                    try {
+                        if (!context.storage.download(request.name, request.guid, request.age, downloaded)) {
+                            throw std::runtime_error("download failed");
+                        }
+                    } catch (std::exception &e) {
+                        finish(i, e.what());
+                        return;
+                    }
+                    download_slot.reset();
+                    queue_parse(i, downloaded);
+                }, priority);
+            }
+        }
+
+        std::unique_lock lock(mutex);
+        done.wait(lock, [&remaining]() { return remaining == 0; });
+        lock.unlock();
+        context.cpu_pool.run([&]() {
+            set_batch_result(req, res, requests, results, errors);
+        }, priority);
+    });
+
+    // upload a private pdb, the body is the raw pdb file
+    // example:
+    // PUT /pdb/mydriver.pdb/ABCDEF.../1
+    // Authorization: Bearer <upload-token>
+    if (!upload_token.empty()) {
+        server.Put(upload_pattern,
+                   [&context, &upload_token](const httplib::Request &req, httplib::Response &res,
+                                             const httplib::ContentReader &content_reader) {
+            if (!is_authorized(req, upload_token)) {
+                res.set_content("unauthorized", "plain/text");
+                res.status = 401;
+                return;
+            }
+
+            auto name = req.matches[1].str();
+            auto guid = req.matches[2].str();
+            auto age = static_cast<uint32_t>(std::stoul(req.matches[3].str()));
+            spdlog::info("upload request: {}/{}/{}", name, guid, age);
+
+            // stream the body straight into the file, memory stays bounded
+            bool success = context.storage.store(name, guid, age, [&content_reader](std::ofstream &f) {
+                return content_reader([&f](const char *data, size_t data_length) {
+                    f.write(data, static_cast<std::streamsize>(data_length));
+                    return f.good();
+                });
+            });
+            if (!success) {
+                res.set_content("invalid pdb", "plain/text");
+                res.status = 400;
+                return;
+            }
+
+            res.set_content("ok", "plain/text");
+        });
+    }
+}
+
+int main(int argc, char *argv[]) {
+    cxxopts::Options option_parser("query-pdb", "pdb query server");
+    option_parser.add_options()
+            ("ip", "ip address", cxxopts::value<std::string>()->default_value("0.0.0.0"))
+            ("port", "port", cxxopts::value<uint16_t>()->default_value("8080"))
+            ("path", "download path", cxxopts::value<std::string>()->default_value("save"))
+            ("server", "download server, http(s):// or file:// (local SymStore), "
+                       "repeat or separate by comma to try several in order",
+                    cxxopts::value<std::vector<std::string>>()->default_value(
+                            "https://msdl.microsoft.com/download/symbols/"))
+            ("watch", "watch the download path for pdb files added by other tools (linux only)")
+            ("cache-size", "number of parsed pdb files kept in memory",
+                    cxxopts::value<size_t>()->default_value("64"))
+            ("response-cache-size", "megabytes of serialized responses kept in memory, 0 disables the cache",
+                    cxxopts::value<size_t>()->default_value("64"))
+            ("memory-stall", "milliseconds per second the tasks of the cgroup may stall waiting for memory "
+                             "before cold parsed pdb files and cached responses are dropped (linux only), "
+                             "0 disables the check",
+                    cxxopts::value<uint32_t>()->default_value("100"))
+            ("memory-usage", "percent of the memory limit of the cgroup in use at which cold parsed pdb files "
+                             "and cached responses are dropped (linux only), 0 disables the check",
+                    cxxopts::value<uint32_t>()->default_value("90"))
+            ("compress-threshold", "compress responses of at least this many bytes "
+                                   "if the client accepts gzip or deflate, 0 disables compression",
+                    cxxopts::value<size_t>()->default_value("1024"))
+            ("parse-threads", "threads parsing pdb files and answering queries, 0 uses one per cpu",
+                    cxxopts::value<size_t>()->default_value("0"))
+            ("download-threads", "number of pdb files downloaded in parallel",
+                    cxxopts::value<size_t>()->default_value("8"))
+            ("max-requests", "requests queued for or running on the parse and download threads, "
+                             "more are rejected with 503, 0 is unlimited",
+                    cxxopts::value<size_t>()->default_value("256"))
+            ("max-downloads", "downloads queued or running, more are rejected with 503, 0 is unlimited",
+                    cxxopts::value<size_t>()->default_value("32"))
+            ("max-cold-parses", "parses of pdb files that are not in memory yet, queued or running, "
+                                "more are rejected with 503, 0 is unlimited",
+                    cxxopts::value<size_t>()->default_value("4"))
+            ("retry-after", "seconds a client rejected with 503 is asked to wait",
+                    cxxopts::value<uint32_t>()->default_value("5"))
+            ("event-loop-threads", "serve connections from this many epoll threads instead of a thread "
+                                   "per connection, for many idle keep-alive clients (linux only), 0 disables",
+                    cxxopts::value<size_t>()->default_value("0"))
+            ("idle-timeout", "seconds an idle keep-alive connection is kept open with --event-loop-threads",
+                    cxxopts::value<uint32_t>()->default_value("300"))
+            ("max-body-size", "kilobytes of a request body read into memory with --event-loop-threads, "
+                              "larger ones are rejected with 413 (uploads are streamed and not limited)",
+                    cxxopts::value<size_t>()->default_value("16384"))
+            ("workers", "number of server processes sharing the port and the download path (linux only), "
+                        "a crashed worker is restarted",
+                    cxxopts::value<size_t>()->default_value("1"))
+            ("unix-socket", "also listen on this unix socket path for clients on the same host, "
+                            "not with --workers",
+                    cxxopts::value<std::string>()->default_value(""))
+            ("shm-path", "also answer /symbol, /struct and /enum queries through a shared memory ring "
+                         "created at this path on tmpfs, e.g. /dev/shm/query-pdb (linux only, see "
+                         "client/qpdb_shm.h), not with --workers",
+                    cxxopts::value<std::string>()->default_value(""))
+            ("shm-slots", "requests the shared memory ring holds at once",
+                    cxxopts::value<uint32_t>()->default_value("64"))
+            ("upload-token", "token required by the pdb upload endpoint, upload is disabled if empty",
+                    cxxopts::value<std::string>()->default_value(""))
+            ("h,help", "print help");
+
+    auto parse_result = option_parser.parse(argc, argv);
+
+    if (parse_result.count("help")) {
+        std::cout << option_parser.help() << std::endl;
+        return 0;
+    }
+
+    const auto ip = parse_result["ip"].as<std::string>();
+    const auto port = parse_result["port"].as<uint16_t>();
+    const auto download_path = parse_result["path"].as<std::string>();
+    const auto download_servers = parse_result["server"].as<std::vector<std::string>>();
+    const auto cache_size = parse_result["cache-size"].as<size_t>();
+    const auto response_cache_size = parse_result["response-cache-size"].as<size_t>();
+    const auto memory_stall = parse_result["memory-stall"].as<uint32_t>();
+    const auto memory_usage = parse_result["memory-usage"].as<uint32_t>();
+    const auto compress_threshold = parse_result["compress-threshold"].as<size_t>();
+    auto parse_threads = parse_result["parse-threads"].as<size_t>();
+    const auto download_threads = parse_result["download-threads"].as<size_t>();
+    const auto max_requests = parse_result["max-requests"].as<size_t>();
+    const auto max_downloads = parse_result["max-downloads"].as<size_t>();
+    const auto max_cold_parses = parse_result["max-cold-parses"].as<size_t>();
+    const auto retry_after = parse_result["retry-after"].as<uint32_t>();
+    const auto event_loop_threads = parse_result["event-loop-threads"].as<size_t>();
+    const auto idle_timeout = parse_result["idle-timeout"].as<uint32_t>();
+    const auto max_body_size = parse_result["max-body-size"].as<size_t>();
+    const auto workers = parse_result["workers"].as<size_t>();
+    const auto unix_socket = parse_result["unix-socket"].as<std::string>();
+    const auto shm_path = parse_result["shm-path"].as<std::string>();
+    const auto shm_slots = parse_result["shm-slots"].as<uint32_t>();
+    const auto upload_token = parse_result["upload-token"].as<std::string>();
+
+    if (memory_stall >= 1000 || memory_usage > 100) {
+        spdlog::error("exit due to invalid --memory-stall or --memory-usage");
+        return 1;
+    }
+
+    // a unix socket path cannot be bound by several processes
+    if (workers > 1 && !unix_socket.empty()) {
+        spdlog::error("exit due to --unix-socket used with --workers");
+        return 1;
+    }
+    if (workers > 1 && !shm_path.empty()) {
+        spdlog::error("exit due to --shm-path used with --workers");
+        return 1;
+    }
+
+    downloader storage(download_path, download_servers);
+    if (!storage.valid()) {
+        spdlog::error("exit due to downloader invalid");
+        return 1;
+    }
+
+    // every worker serves on its own socket from here on, the files in the download
+    // path and the page cache behind the mapped pdb files are shared between them
+    int exit_code = 0;
+    if (workers > 1 && !fork_workers(workers, exit_code)) {
+        return exit_code;
+    }
+
+    if (parse_result.count("watch") && !storage.watch()) {
+        spdlog::warn("watching download path is not supported");
+    }
+
+    set_compress_threshold(compress_threshold);
+    if (compress_threshold && !is_compression_supported()) {
+        spdlog::warn("built without zlib, responses are not compressed");
+    }
+
+    pdb_cache parsers(cache_size);
+    response_cache responses(response_cache_size * 1024 * 1024);
+    request_coalescer inflight;
+
+    // responses are encoded again quickly, a parsed pdb that is still in use stays,
+    // the pages of the evicted ones are released without waiting for their queries
+    memory_pressure pressure(std::chrono::milliseconds(memory_stall), memory_usage, [&parsers, &responses]() {
+        size_t size = responses.clear();
+        size_t evicted = parsers.evict_cold();
+        spdlog::info("dropped under memory pressure, responses: {} bytes, parsed pdb files: {}", size, evicted);
+    });
+    if ((memory_stall || memory_usage) && !pressure.watch() &&
+        (parse_result.count("memory-stall") || parse_result.count("memory-usage"))) {
+        spdlog::warn("watching memory pressure is not supported");
+    }
+
+    if (parse_threads == 0) {
+        parse_threads = std::thread::hardware_concurrency();
+    }
+    work_pool cpu_pool(parse_threads);
+    work_pool io_pool(download_threads);
+    admission_control admission(max_requests, max_downloads, max_cold_parses, retry_after);
+    query_context context{storage, parsers, admission, cpu_pool, io_pool};
+
+    // the routes are served by httplib (a thread per connection) or by the event loops
+    event_server server(event_loop_threads, CPPHTTPLIB_THREAD_POOL_COUNT, std::chrono::seconds(idle_timeout),
+                        max_body_size * 1024);
+    add_routes(server, context, responses, inflight, upload_token);
+    if (!upload_token.empty()) {
+        server.stream_body("PUT", upload_pattern);
+    }
+
+    // callers on the same host that cannot afford http at all
+    shm_server shm(storage, parsers, responses, admission, cpu_pool, io_pool);
+    if (!shm_path.empty()) {
+        if (!shm_server::is_supported()) {
+            spdlog::warn("shared memory queries are not supported on this platform");
+        } else if (!shm.start(shm_path, shm_slots)) {
+            spdlog::error("exit due to shm ring failure, path: {}", shm_path);
+            return 1;
+        }
+    }
+
+    // callers on the same host skip tcp, the unix socket has threads of its own
+    httplib::Server local_server;
+    std::thread local_thread;
+    if (!unix_socket.empty()) {
+        add_routes(local_server, context, responses, inflight, upload_token);
+        local_server.set_address_family(AF_UNIX);
+        // a socket left behind by a previous run would fail the bind
+        std::error_code ec;
+        if (std::filesystem::is_socket(unix_socket, ec)) {
+            std::filesystem::remove(unix_socket, ec);
+        }
+        // the port only has to be nonzero, unix sockets have none
+        if (!local_server.bind_to_port(unix_socket, 80)) {
+            spdlog::error("exit due to unix socket listen failure, path: {}", unix_socket);
+            return 1;
+        }
+        spdlog::info("listen on unix socket, path: {}", unix_socket);
+        local_thread = std::thread([&local_server]() {
+            local_server.listen_after_bind();
+        });
+    }
+    if (event_loop_threads && event_server::is_supported()) {
+        if (!server.listen_events(ip, port)) {
+            spdlog::error("exit due to listen failure");
+            exit_code = 1;
+        }
+    } else {
+        if (event_loop_threads) {
+            spdlog::warn("event loops are not supported on this platform");
+        }
+        server.listen(ip, port);
+    }
+    if (local_thread.joinable()) {
+        local_server.stop();
+        local_thread.join();
+        std::error_code ec;
+        std::filesystem::remove(unix_socket, ec);
+    }
+    shm.stop();
+    cpu_pool.shutdown();
+    io_pool.shutdown();
+    return exit_code;
 }
@@ -0,0 +1,206 @@
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <limits>
+#include <string>
+#include <spdlog/spdlog.h>
+#ifdef __linux__
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+#include "memory_pressure.h"
+
+// trimmed caches take a while to show in the numbers, the caches are not emptied
+// at once by a pressure that is still reported
+static constexpr std::chrono::seconds relief_interval(2);
+
+// the psi window, unprivileged triggers need a multiple of 2s
+static constexpr std::chrono::seconds trigger_window(2);
+
+// the directory of the cgroup v2 of the process, empty if there is none
+static std::filesystem::path find_cgroup() {
+    std::ifstream file("/proc/self/cgroup");
+    std::string line;
+    while (std::getline(file, line)) {
+        // "0::/path" is the unified hierarchy, mounted on its own or next to v1
+        if (line.rfind("0::/", 0) != 0) {
+            continue;
+        }
+        for (const char *root: {"/sys/fs/cgroup", "/sys/fs/cgroup/unified"}) {
+            std::filesystem::path dir = root + line.substr(3);
+            std::error_code ec;
+            if (std::filesystem::exists(dir / "memory.pressure", ec)) {
+                return dir;
+            }
+        }
+    }
+    return {};
+}
+
+// a number in a cgroup file, false if the file is missing or says "max"
+static bool read_value(const std::filesystem::path &path, uint64_t &value) {
+    std::ifstream file(path);
+    return static_cast<bool>(file >> value);
+}
+
+memory_pressure::memory_pressure(std::chrono::milliseconds stall, uint32_t usage_percent,
+                                 std::function<void()> relieve)
+        : stall_(stall),
+          usage_percent_(usage_percent),
+          relieve_(std::move(relieve)),
+          trigger_fd_(-1),
+          trimmed_usage_(0),
+          stop_(false) {}
+
+memory_pressure::~memory_pressure() {
+    stop_ = true;
+    if (watch_thread_.joinable()) {
+        watch_thread_.join();
+    }
+#ifdef __linux__
+    if (trigger_fd_ != -1) {
+        close(trigger_fd_);
+    }
+#endif
+}
+
+bool memory_pressure::watch() {
+#ifdef __linux__
+    cgroup_ = find_cgroup();
+    pressure_path_ = cgroup_.empty() ? "/proc/pressure/memory" : cgroup_ / "memory.pressure";
+    std::error_code ec;
+    if (!std::filesystem::exists(pressure_path_, ec)) {
+        stall_ = std::chrono::milliseconds(0);
+    }
+    if (cgroup_.empty() || !std::filesystem::exists(cgroup_ / "memory.current", ec)) {
+        usage_percent_ = 0;
+    }
+    if (stall_.count() == 0 && usage_percent_ == 0) {
+        return false;
+    }
+
+    if (stall_.count() && !open_trigger()) {
+        spdlog::info("psi trigger not available, reading memory pressure averages");
+    }
+    watch_thread_ = std::thread(&memory_pressure::watch_loop, this);
+    spdlog::info("watch memory pressure, path: {}, stall: {}ms, usage: {}%",
+                 pressure_path_.string(), stall_.count(), usage_percent_);
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool memory_pressure::open_trigger() {
+#ifdef __linux__
+    int fd = open(pressure_path_.c_str(), O_RDWR | O_NONBLOCK | O_CLOEXEC);
+    if (fd == -1) {
+        return false;
+    }
+    // "some": at least one task waited, the stall is given per window
+    auto window = std::chrono::duration_cast<std::chrono::microseconds>(trigger_window);
+    auto stall = std::chrono::duration_cast<std::chrono::microseconds>(stall_) * trigger_window.count();
+    std::string trigger = "some " + std::to_string(stall.count()) + " " + std::to_string(window.count());
+    if (write(fd, trigger.c_str(), trigger.size() + 1) == -1) {
+        close(fd);
+        return false;
+    }
+    trigger_fd_ = fd;
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool memory_pressure::is_stalled() const {
+    // "some avg10=1.50 avg60=0.20 avg300=0.05 total=123456", the averages are percent
+    std::ifstream file(pressure_path_);
+    std::string line;
+    double average = 0;
+    if (!std::getline(file, line) || std::sscanf(line.c_str(), "some avg10=%lf", &average) != 1) {
+        return false;
+    }
+    return average * 10 >= static_cast<double>(stall_.count());
+}
+
+// a counter of memory.stat, 0 if it is missing
+static uint64_t read_stat(const std::filesystem::path &path, const std::string &name) {
+    std::ifstream file(path);
+    std::string key;
+    uint64_t value = 0;
+    while (file >> key >> value) {
+        if (key == name) {
+            return value;
+        }
+    }
+    return 0;
+}
+
+bool memory_pressure::is_near_limit(uint64_t &usage) const {
+    uint64_t current = 0;
+    if (!read_value(cgroup_ / "memory.current", current)) {
+        return false;
+    }
+    // clean page cache nobody touched lately is reclaimed before anything else, the
+    // rest counts like anonymous memory (what the kubelet calls the working set)
+    uint64_t inactive_file = read_stat(cgroup_ / "memory.stat", "inactive_file");
+    usage = current > inactive_file ? current - inactive_file : 0;
+    // memory.high throttles the tasks before memory.max gets them killed
+    uint64_t limit = std::numeric_limits<uint64_t>::max();
+    for (const char *name: {"memory.high", "memory.max"}) {
+        uint64_t value = 0;
+        if (read_value(cgroup_ / name, value)) {
+            limit = std::min(limit, value);
+        }
+    }
+    return limit != std::numeric_limits<uint64_t>::max() && usage >= limit / 100 * usage_percent_;
+}
+
+void memory_pressure::watch_loop() {
+#ifdef __linux__
+    auto last_relief = std::chrono::steady_clock::time_point();
+    while (!stop_) {
+        bool stalled = false;
+        if (trigger_fd_ != -1) {
+            pollfd pfd{trigger_fd_, POLLPRI, 0};
+            if (poll(&pfd, 1, 500) > 0) {
+                if (pfd.revents & POLLERR) {
+                    // the cgroup is gone, its file only reports errors from now on
+                    close(trigger_fd_);
+                    trigger_fd_ = -1;
+                    continue;
+                }
+                stalled = pfd.revents & POLLPRI;
+            }
+        } else {
+            poll(nullptr, 0, 500);
+            stalled = stall_.count() && is_stalled();
+        }
+        uint64_t usage = 0;
+        bool near_limit = usage_percent_ && is_near_limit(usage);
+        if (!near_limit) {
+            trimmed_usage_ = 0;
+        }
+
+        auto now = std::chrono::steady_clock::now();
+        if ((!stalled && !near_limit) || now - last_relief < relief_interval) {
+            continue;
+        }
+        // a trim that did not lower the usage will not the next time either, the memory
+        // is not held by the caches. trimmed again once the usage was below the limit
+        if (near_limit && trimmed_usage_ != 0 && usage >= trimmed_usage_) {
+            near_limit = false;
+            if (!stalled) {
+                continue;
+            }
+        }
+        if (near_limit) {
+            trimmed_usage_ = usage;
+        }
+        last_relief = now;
+        spdlog::warn("relieve memory pressure, stalled: {}, near limit: {}", stalled, near_limit);
+        relieve_();
+    }
+#endif
+}
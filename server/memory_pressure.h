@@ -0,0 +1,58 @@
+#ifndef QUERY_PDB_SERVER_MEMORY_PRESSURE_H
+#define QUERY_PDB_SERVER_MEMORY_PRESSURE_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <thread>
+
+// watches the memory of the cgroup the server runs in (cgroup v2, linux only) and calls
+// relieve when its tasks stall waiting for memory or its usage gets close to the limit,
+// the caches are trimmed before the kernel reclaims pages the queries need or the oom
+// killer ends the process. the usage leaves out file pages the kernel can drop on its
+// own (the downloaded and mapped pdb files mostly), trimming would not lower them.
+// stalls are reported by a psi trigger on memory.pressure, without one (older kernels,
+// no permission) the averages in the file are read. outside of a cgroup v2 the pressure
+// of the whole system is watched and there is no limit
+class memory_pressure {
+public:
+    // stall: time per second the tasks may wait for memory, usage_percent: of the lower
+    // of memory.high and memory.max. 0 disables the check. a trim for the usage is only
+    // repeated while the previous one lowered it
+    memory_pressure(std::chrono::milliseconds stall, uint32_t usage_percent, std::function<void()> relieve);
+
+    ~memory_pressure();
+
+    // starts the watch thread, false if neither check is possible
+    bool watch();
+
+    memory_pressure(const memory_pressure &) = delete;
+
+    memory_pressure &operator=(const memory_pressure &) = delete;
+
+private:
+    std::chrono::milliseconds stall_;
+    uint32_t usage_percent_;
+    std::function<void()> relieve_;
+    // empty if the server is not in a cgroup v2
+    std::filesystem::path cgroup_;
+    std::filesystem::path pressure_path_;
+    int trigger_fd_;
+    // usage when it was last trimmed for, 0 once it is below the limit again
+    uint64_t trimmed_usage_;
+    std::atomic<bool> stop_;
+    std::thread watch_thread_;
+
+    bool open_trigger();
+
+    bool is_stalled() const;
+
+    // usage is memory.current without inactive file pages
+    bool is_near_limit(uint64_t &usage) const;
+
+    void watch_loop();
+};
+
+#endif //QUERY_PDB_SERVER_MEMORY_PRESSURE_H
@@ -0,0 +1,161 @@
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <vector>
+#include <openssl/evp.h>
+#include <spdlog/spdlog.h>
+#include "file_util.h"
+#include "object_store.h"
+
+// an object placed by a concurrent ingest run or server is linked to its key right
+// after, only objects left unreferenced for longer than this are garbage
+static constexpr std::chrono::minutes garbage_grace(10);
+
+object_store::object_store(const std::filesystem::path &path)
+        : root_(std::filesystem::path(path).append(".objects")) {}
+
+bool object_store::insert(const std::filesystem::path &src, const std::filesystem::path &key_path,
+                          bool move_source) {
+    std::string hash;
+    if (!hash_file(src, hash)) {
+        spdlog::error("failed to hash file, path: {}", src.string());
+        return false;
+    }
+
+    std::error_code ec;
+    auto object_path = get_object_path(hash);
+    if (std::filesystem::exists(object_path, ec)) {
+        spdlog::info("deduplicate pdb, object: {}", hash);
+        // the startup gc of another process may remove the object until a key links
+        // to it, the source is kept until then to store the content again
+        if (link_key(object_path, key_path)) {
+            if (move_source) {
+                std::filesystem::remove(src, ec);
+            }
+            return true;
+        }
+        if (std::filesystem::exists(object_path, ec)) {
+            if (move_source) {
+                std::filesystem::remove(src, ec);
+            }
+            return false;
+        }
+        spdlog::warn("object removed while linking it, store it again, object: {}", hash);
+    }
+
+    if (move_source) {
+        std::filesystem::create_directories(object_path.parent_path(), ec);
+        std::filesystem::rename(src, object_path, ec);
+        if (ec) {
+            spdlog::error("failed to rename file, from: {}, to: {}, error: {}",
+                          src.string(), object_path.string(), ec.message());
+            std::filesystem::remove(src, ec);
+            return false;
+        }
+    } else if (!place_file(src, object_path)) {
+        return false;
+    }
+
+    // a new object was just written (or is a hardlink of src), the gc leaves it alone
+    return link_key(object_path, key_path);
+}
+
+size_t object_store::collect_garbage() {
+    size_t count = 0;
+    std::error_code ec;
+    for (auto it = std::filesystem::recursive_directory_iterator(root_, ec);
+         !ec && it != std::filesystem::recursive_directory_iterator(); it.increment(ec)) {
+        std::error_code entry_ec;
+        if (!it->is_regular_file(entry_ec)) {
+            continue;
+        }
+
+        // only the object itself is left, no key refers to it
+        if (it->hard_link_count(entry_ec) != 1 || entry_ec) {
+            continue;
+        }
+        auto written = it->last_write_time(entry_ec);
+        if (entry_ec || std::filesystem::file_time_type::clock::now() - written < garbage_grace) {
+            continue;
+        }
+        spdlog::info("remove unreferenced object, path: {}", it->path().string());
+        std::filesystem::remove(it->path(), entry_ec);
+        count++;
+    }
+    return count;
+}
+
+std::filesystem::path object_store::get_object_path(const std::string &hash) const {
+    return std::filesystem::path(root_).append(hash.substr(0, 2)).append(hash);
+}
+
+bool object_store::hash_file(const std::filesystem::path &path, std::string &hash) {
+    std::ifstream f(path, std::ios::binary);
+    if (!f.is_open()) {
+        return false;
+    }
+
+    std::unique_ptr<EVP_MD_CTX, decltype(&EVP_MD_CTX_free)> ctx(EVP_MD_CTX_new(), EVP_MD_CTX_free);
+    if (!ctx || EVP_DigestInit_ex(ctx.get(), EVP_sha256(), nullptr) != 1) {
+        return false;
+    }
+
+    // read in blocks, memory stays bounded for any file size
+    std::vector<char> buf(1024 * 1024);
+    while (f) {
+        f.read(buf.data(), static_cast<std::streamsize>(buf.size()));
+        if (f.gcount() > 0 &&
+            EVP_DigestUpdate(ctx.get(), buf.data(), static_cast<size_t>(f.gcount())) != 1) {
+            return false;
+        }
+    }
+    if (f.bad()) {
+        return false;
+    }
+
+    unsigned char digest[EVP_MAX_MD_SIZE];
+    unsigned int digest_size = 0;
+    if (EVP_DigestFinal_ex(ctx.get(), digest, &digest_size) != 1) {
+        return false;
+    }
+
+    static const char hex[] = "0123456789abcdef";
+    hash.clear();
+    for (unsigned int i = 0; i < digest_size; i++) {
+        hash.push_back(hex[digest[i] >> 4]);
+        hash.push_back(hex[digest[i] & 0xf]);
+    }
+    return true;
+}
+
+bool object_store::link_key(const std::filesystem::path &object_path,
+                            const std::filesystem::path &key_path) {
+    std::error_code ec;
+    if (std::filesystem::equivalent(object_path, key_path, ec)) {
+        return true;
+    }
+
+    std::filesystem::create_directories(key_path.parent_path(), ec);
+    auto tmp_path = get_unique_tmp_path(key_path);
+    std::filesystem::create_hard_link(object_path, tmp_path, ec);
+    if (ec) {
+        // the file system does not support hardlinks, keep a private copy
+        spdlog::warn("failed to link object, path: {}, error: {}", key_path.string(), ec.message());
+        std::filesystem::copy_file(object_path, tmp_path, ec);
+        if (ec) {
+            spdlog::error("failed to copy object, path: {}, error: {}",
+                          key_path.string(), ec.message());
+            std::filesystem::remove(tmp_path, ec);
+            return false;
+        }
+    }
+
+    std::filesystem::rename(tmp_path, key_path, ec);
+    if (ec) {
+        spdlog::error("failed to rename file, from: {}, to: {}, error: {}",
+                      tmp_path.string(), key_path.string(), ec.message());
+        std::filesystem::remove(tmp_path, ec);
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,36 @@
+#ifndef QUERY_PDB_SERVER_OBJECT_STORE_H
+#define QUERY_PDB_SERVER_OBJECT_STORE_H
+
+#include <string>
+#include <filesystem>
+
+// content addressed storage below the download path.
+// every distinct file is kept once as ".objects/<xx>/<sha256>", the
+// "name/GUIDAGE/name" keys are hardlinks to it, so the link count of an
+// object is its reference count and identical pdb files share one inode
+// (and so one page cache copy and one parsed instance in pdb_cache)
+class object_store {
+public:
+    explicit object_store(const std::filesystem::path &path);
+
+    // store the content of src and make key_path refer to it.
+    // src is consumed when move_source is set (e.g. a temporary download),
+    // otherwise it is linked or copied
+    bool insert(const std::filesystem::path &src, const std::filesystem::path &key_path,
+                bool move_source);
+
+    // remove objects no key has referred to for a while, returns the removed count
+    size_t collect_garbage();
+
+private:
+    std::filesystem::path root_;
+
+    std::filesystem::path get_object_path(const std::string &hash) const;
+
+    static bool hash_file(const std::filesystem::path &path, std::string &hash);
+
+    static bool link_key(const std::filesystem::path &object_path,
+                         const std::filesystem::path &key_path);
+};
+
+#endif //QUERY_PDB_SERVER_OBJECT_STORE_H
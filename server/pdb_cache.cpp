@@ -0,0 +1,133 @@
+#include <algorithm>
+#include <spdlog/spdlog.h>
+#include "pdb_cache.h"
+
+pdb_cache::pdb_cache(size_t capacity)
+        : capacity_(capacity),
+          snapshot_(new snapshot()),
+          generation_(0) {}
+
+pdb_cache::~pdb_cache() {
+    const snapshot *current = snapshot_.load();
+    for (entry *e: *current) {
+        delete e;
+    }
+    delete current;
+}
+
+bool pdb_cache::is_before(const entry *e, const file_id &id) {
+    return e->id < id;
+}
+
+pdb_cache::entry *pdb_cache::lookup(const file_id &id) {
+    const snapshot *current = snapshot_.load();
+    auto it = std::lower_bound(current->begin(), current->end(), id, is_before);
+    if (it == current->end() || !((*it)->id == id)) {
+        return nullptr;
+    }
+
+    // written only once per generation, hits on a hot parser keep its line shared
+    uint64_t generation = generation_.load(std::memory_order_relaxed);
+    if ((*it)->used.load(std::memory_order_relaxed) != generation) {
+        (*it)->used.store(generation, std::memory_order_relaxed);
+    }
+    return *it;
+}
+
+pdb_cache::pin pdb_cache::find(const pdb_location &location) {
+    pin p;
+    p.guard_ = reclaimer_.enter();
+    if (entry *e = lookup(location.id)) {
+        p.parser_ = e->parser.get();
+        return p;
+    }
+    return {};
+}
+
+pdb_cache::pin pdb_cache::get(const pdb_location &location) {
+    if (auto p = find(location)) {
+        return p;
+    }
+
+    // parse outside the lock, other pdb files stay available meanwhile
+    auto parser = std::make_unique<const pdb_parser>(location.path.string());
+
+    const file_id &id = location.id;
+    pin p;
+    if (capacity_ == 0) {
+        p.parser_ = parser.get();
+        p.owned_ = std::move(parser);
+        return p;
+    }
+
+    p.guard_ = reclaimer_.enter();
+    std::lock_guard lock(mutex_);
+    if (entry *e = lookup(id)) {
+        // parsed concurrently by another request, keep the cached one
+        p.parser_ = e->parser.get();
+        return p;
+    }
+
+    // readers keep using the current snapshot until the copy replaces it
+    const snapshot *current = snapshot_.load();
+    auto next = std::make_unique<snapshot>(*current);
+    uint64_t generation = generation_.fetch_add(1) + 1;
+    auto added = new entry(id, std::move(parser), generation);
+    next->insert(std::lower_bound(next->begin(), next->end(), id, is_before), added);
+
+    entry *evicted = nullptr;
+    if (next->size() > capacity_) {
+        auto oldest = std::min_element(next->begin(), next->end(), [](const entry *a, const entry *b) {
+            return a->used.load(std::memory_order_relaxed) < b->used.load(std::memory_order_relaxed);
+        });
+        evicted = *oldest;
+        next->erase(oldest);
+    }
+    size_t cached = next->size();
+    snapshot_.store(next.release());
+
+    // pins taken from the old snapshot keep the evicted parser mapped
+    reclaimer_.retire([current, evicted]() {
+        delete current;
+        delete evicted;
+    });
+
+    spdlog::info("cache pdb, path: {}, cached: {}", location.path.string(), cached);
+    p.parser_ = added->parser.get();
+    return p;
+}
+
+size_t pdb_cache::evict_cold() {
+    std::lock_guard lock(mutex_);
+    // parsers found from now on carry the next generation and count as hot next time
+    uint64_t generation = generation_.fetch_add(1);
+    const snapshot *current = snapshot_.load();
+    auto next = std::make_unique<snapshot>();
+    std::vector<entry *> evicted;
+    for (entry *e: *current) {
+        if (e->used.load(std::memory_order_relaxed) == generation) {
+            next->push_back(e);
+        } else {
+            evicted.push_back(e);
+        }
+    }
+    if (evicted.empty()) {
+        return 0;
+    }
+    size_t cached = next->size();
+    snapshot_.store(next.release());
+
+    // the memory of the parsers waits for the last pin, the mapped pages do not
+    for (entry *e: evicted) {
+        e->parser->release_pages();
+    }
+    reclaimer_.retire([current, evicted]() {
+        delete current;
+        for (entry *e: evicted) {
+            delete e;
+        }
+    });
+
+    spdlog::info("evict cold pdb files, evicted: {}, cached: {}", evicted.size(), cached);
+    return evicted.size();
+}
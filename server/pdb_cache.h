@@ -0,0 +1,96 @@
+#ifndef QUERY_PDB_SERVER_PDB_CACHE_H
+#define QUERY_PDB_SERVER_PDB_CACHE_H
+
+#include <atomic>
+#include <mutex>
+#include <memory>
+#include <vector>
+#include <filesystem>
+#include "epoch_reclaimer.h"
+#include "file_util.h"
+#include "pdb_parser.h"
+#include "presence_index.h"
+
+// keeps recently used parsers (mapped file + validated streams) alive.
+// entries are keyed by file identity, every key linked to the same
+// object in object_store shares one parser.
+// readers take no lock: they search an immutable snapshot of the entries and pin the
+// parser with an epoch guard. a new parser is added to a copy of the snapshot under
+// a mutex, the copy replaces the snapshot and the old one is retired. an evicted
+// parser is destroyed, and its file unmapped, once no pin can reach it anymore
+class pdb_cache {
+public:
+    // a parser that stays valid as long as the pin lives, may be moved between threads
+    class pin {
+    public:
+        pin() = default;
+
+        const pdb_parser &operator*() const {
+            return *parser_;
+        }
+
+        const pdb_parser *operator->() const {
+            return parser_;
+        }
+
+        explicit operator bool() const {
+            return parser_ != nullptr;
+        }
+
+    private:
+        friend class pdb_cache;
+
+        epoch_reclaimer::guard guard_;
+        const pdb_parser *parser_ = nullptr;
+        // the parser of a cache without capacity belongs to the pin
+        std::unique_ptr<const pdb_parser> owned_;
+    };
+
+    explicit pdb_cache(size_t capacity);
+
+    // no pin may be left
+    ~pdb_cache();
+
+    pin get(const pdb_location &location);
+
+    // the cached parser of location, empty if getting it would parse the pdb
+    pin find(const pdb_location &location);
+
+    // evicts the parsers not found since the last parser was added or since the previous
+    // call, returns how many. their pages are unmapped right away (see
+    // pdb_parser::release_pages), pins still using them read the pages in again
+    size_t evict_cold();
+
+private:
+    struct entry {
+        file_id id;
+        std::unique_ptr<const pdb_parser> parser;
+        // generation of the cache when the entry was last found, the least recently
+        // used entry is approximated without writing to it on every hit
+        std::atomic<uint64_t> used;
+
+        entry(const file_id &id, std::unique_ptr<const pdb_parser> parser, uint64_t used)
+                : id(id),
+                  parser(std::move(parser)),
+                  used(used) {}
+    };
+
+    // sorted by id, never changed once published
+    using snapshot = std::vector<entry *>;
+
+    size_t capacity_;
+    epoch_reclaimer reclaimer_;
+    std::atomic<const snapshot *> snapshot_;
+    // advanced by every added parser and by evict_cold
+    std::atomic<uint64_t> generation_;
+    // held by writers only
+    std::mutex mutex_;
+
+    static bool is_before(const entry *e, const file_id &id);
+
+    // the entry of id in the current snapshot, nullptr if there is none.
+    // a guard has to be held while the entry is used
+    entry *lookup(const file_id &id);
+};
+
+#endif //QUERY_PDB_SERVER_PDB_CACHE_H
@@ -1,34 +1,102 @@
 #include <spdlog/spdlog.h>
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
 #include "pdb_helper.h"
 #include "pdb_parser.h"
 
 pdb_parser::pdb_parser(const std::string &filename)
-        : file_(MemoryMappedFile::Open(filename.c_str())) {}
+        : file_(MemoryMappedFile::Open(filename.c_str())),
+          raw_file_(PDB::CreateRawFile(validate_file(file_))) {
 
-std::map<std::string, int64_t> pdb_parser::get_symbols(const std::set<std::string> &names) const {
-    return call_with_pdb_stream(get_symbols_impl, names);
+    if (PDB::HasValidDBIStream(raw_file_) != PDB::ErrorCode::Success) {
+        throw std::runtime_error("invalid DBI stream");
+    }
+
+    const PDB::InfoStream info_stream(raw_file_);
+    if (info_stream.UsesDebugFastLink()) {
+        throw std::runtime_error("invalid info stream");
+    }
+
+    dbi_stream_ = PDB::CreateDBIStream(raw_file_);
+    if (dbi_stream_.HasValidImageSectionStream(raw_file_) != PDB::ErrorCode::Success ||
+        dbi_stream_.HasValidPublicSymbolStream(raw_file_) != PDB::ErrorCode::Success ||
+        dbi_stream_.HasValidGlobalSymbolStream(raw_file_) != PDB::ErrorCode::Success ||
+        dbi_stream_.HasValidSectionContributionStream(raw_file_) != PDB::ErrorCode::Success) {
+        throw std::runtime_error("invalid DBI streams");
+    }
+
+    if (PDB::HasValidTPIStream(raw_file_) != PDB::ErrorCode::Success) {
+        throw std::runtime_error("invalid TPI stream");
+    }
+    tpi_stream_ = PDB::CreateTPIStream(raw_file_);
+}
+
+const void *pdb_parser::validate_file(const handle_guard &file) {
+    // sanity check
+    const MemoryMappedFile::Handle &handle = file.get();
+    if (!handle.baseAddress || handle.len < static_cast<long long>(sizeof(PDB::SuperBlock)) ||
+        PDB::ValidateFile(handle.baseAddress) != PDB::ErrorCode::Success) {
+        throw std::runtime_error("invalid PDB file");
+    }
+    // raw_pdb reads blocks without bounds checks, a truncated file would fault
+    auto super_block = static_cast<const PDB::SuperBlock *>(handle.baseAddress);
+    if (static_cast<uint64_t>(super_block->blockSize) * super_block->blockCount >
+        static_cast<uint64_t>(handle.len)) {
+        throw std::runtime_error("truncated PDB file");
+    }
+    return handle.baseAddress;
 }
 
-std::map<std::string, std::map<std::string, field_info>>
-pdb_parser::get_struct(const std::map<std::string, std::set<std::string>> &names) const {
-    return call_with_pdb_stream(get_struct_impl, names);
+symbol_result pdb_parser::get_symbols(const name_set &names, std::pmr::memory_resource *memory) const {
+    return call_with_pdb_stream(get_symbols_impl, names, memory);
 }
 
-std::map<std::string, std::map<std::string, int64_t>>
-pdb_parser::get_enum(const std::map<std::string, std::set<std::string>> &names) const {
-    return call_with_pdb_stream(get_enum_impl, names);
+struct_result pdb_parser::get_struct(const member_set &names, std::pmr::memory_resource *memory) const {
+    return call_with_pdb_stream(get_struct_impl, names, memory);
+}
+
+enum_result pdb_parser::get_enum(const member_set &names, std::pmr::memory_resource *memory) const {
+    return call_with_pdb_stream(get_enum_impl, names, memory);
+}
+
+pdb_query_result pdb_parser::query(const pdb_query &q, std::pmr::memory_resource *memory) const {
+    return call_with_pdb_stream(query_impl, q, memory);
 }
 
 pdb_stats pdb_parser::get_stats() {
     return call_with_pdb_stream(get_stats_impl);
 }
 
-std::map<std::string, int64_t>
+pdb_info pdb_parser::get_info() {
+    return call_with_pdb_stream(get_info_impl);
+}
+
+void pdb_parser::release_pages() const {
+#ifdef __linux__
+    // the mapping is private and never written, nothing is lost
+    const MemoryMappedFile::Handle &handle = file_.get();
+    if (madvise(handle.baseAddress, handle.len, MADV_DONTNEED) != 0) {
+        spdlog::warn("failed to release pages of mapped pdb");
+    }
+#endif
+}
+
+// the first definition of a name wins
+static void set_symbol(const name_set &names, symbol_result &result, const char *name, int64_t rva) {
+    size_t index = names.index(name);
+    if (index != names.size() && result[index] == -1) {
+        result[index] = rva;
+    }
+}
+
+symbol_result
 pdb_parser::get_symbols_impl(
         const PDB::RawFile &raw_file,
         const PDB::DBIStream &dbi_stream,
         const PDB::TPIStream &tpi_stream,
-        const std::set<std::string> &names
+        const name_set &names,
+        std::pmr::memory_resource *memory
 ) {
     const PDB::ImageSectionStream image_section_stream =
             dbi_stream.CreateImageSectionStream(raw_file);
@@ -37,7 +105,7 @@ pdb_parser::get_symbols_impl(
     const PDB::CoalescedMSFStream symbol_record_stream =
             dbi_stream.CreateSymbolRecordStream(raw_file);
 
-    std::map<std::string, int64_t> result;
+    symbol_result result(names.size(), -1, memory);
 
     // read public symbols
     const PDB::PublicSymbolStream public_symbol_stream =
@@ -58,9 +126,7 @@ pdb_parser::get_symbols_impl(
             }
 
             auto name = record->data.S_PUB32.name;
-            if (names.find(name) != names.end()) {
-                result.insert({name, rva});
-            }
+            set_symbol(names, result, name, rva);
         }
     }
 
@@ -108,9 +174,7 @@ pdb_parser::get_symbols_impl(
                 // don't have a valid RVA, ignore those
                 continue;
             }
-            if (names.find(name) != names.end()) {
-                result.insert({name, rva});
-            }
+            set_symbol(names, result, name, rva);
         }
     }
 
@@ -201,87 +265,80 @@ pdb_parser::get_symbols_impl(
                 return;
             }
 
-            if (names.find(name) != names.end()) {
-                result.insert({name, rva});
-            }
+            set_symbol(names, result, name, rva);
         });
     }
 
-    for (const std::string &name: names) {
-        if (result.find(name) == result.end()) {
-            result.insert({name, -1});
-        }
-    }
-
     return result;
 }
 
-std::map<std::string, std::map<std::string, field_info>>
+struct_result
 pdb_parser::get_struct_impl(
         const PDB::RawFile &raw_file,
         const PDB::DBIStream &dbi_stream,
         const PDB::TPIStream &tpi_stream,
-        const std::map<std::string, std::set<std::string>> &names
+        const member_set &names,
+        std::pmr::memory_resource *memory
 ) {
-    std::map<std::string, std::map<std::string, field_info>> result;
+    struct_result result(names, memory);
 
     for (const auto &record: tpi_stream.GetTypeRecords()) {
-        if (record->header.kind == PDB::CodeView::TPI::TypeRecordKind::LF_STRUCTURE) {
-            if (record->data.LF_CLASS.property.fwdref)
-                continue;
-
-            auto type_record = tpi_stream.GetTypeRecord(record->data.LF_CLASS.field);
-            if (!type_record)
-                continue;
-
-            auto leaf_name = GetLeafName(
-                    record->data.LF_CLASS.data, record->data.LF_CLASS.lfEasy.kind);
-
-            if (auto it = names.find(leaf_name); it != names.end()) {
-                std::map<std::string, field_info> fields =
-                        get_struct_single(tpi_stream, type_record, it->second);
-                result.insert({it->first, fields});
-            }
-        } else if (record->header.kind == PDB::CodeView::TPI::TypeRecordKind::LF_UNION) {
-            if (record->data.LF_UNION.property.fwdref)
-                continue;
-
-            auto type_record = tpi_stream.GetTypeRecord(record->data.LF_UNION.field);
-            if (!type_record)
-                continue;
-
-            auto leaf_name = GetLeafName(
-                    record->data.LF_UNION.data, static_cast<PDB::CodeView::TPI::TypeRecordKind>(0));
-
-            if (auto it = names.find(leaf_name); it != names.end()) {
-                std::map<std::string, field_info> fields =
-                        get_struct_single(tpi_stream, type_record, it->second);
-                result.insert({it->first, fields});
-            }
-        }
+        collect_struct(tpi_stream, record, names, result);
     }
 
-    for (const auto &[name, fields]: names) {
-        if (result.find(name) == result.end()) {
-            std::map<std::string, field_info> empty_fields;
-            for (const auto &field: fields) {
-                empty_fields.insert({field, {}});
-            }
+    return result;
+}
 
-            result.insert({name, empty_fields});
+void pdb_parser::collect_struct(
+        const PDB::TPIStream &tpi_stream,
+        const PDB::CodeView::TPI::Record *record,
+        const member_set &names,
+        struct_result &result
+) {
+    if (record->header.kind == PDB::CodeView::TPI::TypeRecordKind::LF_STRUCTURE) {
+        if (record->data.LF_CLASS.property.fwdref)
+            return;
+
+        auto type_record = tpi_stream.GetTypeRecord(record->data.LF_CLASS.field);
+        if (!type_record)
+            return;
+
+        auto leaf_name = GetLeafName(
+                record->data.LF_CLASS.data, record->data.LF_CLASS.lfEasy.kind);
+
+        const member_set::entry *entry = names.find(leaf_name);
+        if (entry && !result.found[names.index(*entry)]) {
+            result.found[names.index(*entry)] = true;
+            get_struct_single(tpi_stream, type_record, entry->members,
+                              result.fields.data() + entry->first);
+        }
+    } else if (record->header.kind == PDB::CodeView::TPI::TypeRecordKind::LF_UNION) {
+        if (record->data.LF_UNION.property.fwdref)
+            return;
+
+        auto type_record = tpi_stream.GetTypeRecord(record->data.LF_UNION.field);
+        if (!type_record)
+            return;
+
+        auto leaf_name = GetLeafName(
+                record->data.LF_UNION.data, static_cast<PDB::CodeView::TPI::TypeRecordKind>(0));
+
+        const member_set::entry *entry = names.find(leaf_name);
+        if (entry && !result.found[names.index(*entry)]) {
+            result.found[names.index(*entry)] = true;
+            get_struct_single(tpi_stream, type_record, entry->members,
+                              result.fields.data() + entry->first);
         }
     }
-    return result;
 }
 
-std::map<std::string, field_info>
+void
 pdb_parser::get_struct_single(
         const PDB::TPIStream &tpi_stream,
         const PDB::CodeView::TPI::Record *record,
-        const std::set<std::string> &names
+        const name_set &names,
+        field_info *fields
 ) {
-    std::map<std::string, field_info> result;
-
     const PDB::CodeView::TPI::Record *referenced_type = nullptr;
     const PDB::CodeView::TPI::Record *modifier_record = nullptr;
     const char *leaf_name = nullptr;
@@ -324,15 +381,14 @@ pdb_parser::get_struct_single(
                                     pointer_level, &referenced_type,
                                     &modifier_record);
 
-            if (names.find(leaf_name) != names.end()) {
-                field_info info{};
-                info.offset = offset;
+            size_t index = names.index(leaf_name);
+            if (index != names.size() && fields[index].offset == -1) {
+                fields[index].offset = offset;
                 if (referenced_type &&
                     referenced_type->header.kind ==
                     PDB::CodeView::TPI::TypeRecordKind::LF_BITFIELD) {
-                    info.bitfield_offset = referenced_type->data.LF_BITFIELD.position;
+                    fields[index].bitfield_offset = referenced_type->data.LF_BITFIELD.position;
                 }
-                result.insert({leaf_name, info});
             }
         } else if (field_record->kind == PDB::CodeView::TPI::TypeRecordKind::LF_NESTTYPE) {
             leaf_name = &field_record->data.LF_NESTTYPE.name[0];
@@ -361,65 +417,58 @@ pdb_parser::get_struct_single(
         i += strnlen(leaf_name, maximum_size - i - 1) + 1;
         i = (i + (sizeof(uint32_t) - 1)) & (0 - sizeof(uint32_t));
     }
-
-    for (const std::string &name: names) {
-        if (result.find(name) == result.end()) {
-            result.insert({name, {}});
-        }
-    }
-
-    return result;
 }
 
-std::map<std::string, std::map<std::string, int64_t>>
+enum_result
 pdb_parser::get_enum_impl(
         const PDB::RawFile &raw_file,
         const PDB::DBIStream &dbi_stream,
         const PDB::TPIStream &tpi_stream,
-        const std::map<std::string, std::set<std::string>> &names
+        const member_set &names,
+        std::pmr::memory_resource *memory
 ) {
-    std::map<std::string, std::map<std::string, int64_t>> result;
+    enum_result result(names, memory);
 
     for (const auto &record: tpi_stream.GetTypeRecords()) {
-        if (record->header.kind == PDB::CodeView::TPI::TypeRecordKind::LF_ENUM) {
-            if (record->data.LF_ENUM.property.fwdref)
-                continue;
-
-            auto type_record = tpi_stream.GetTypeRecord(record->data.LF_ENUM.field);
-            if (!type_record)
-                continue;
-
-            auto leaf_name = record->data.LF_ENUM.name;
-            if (auto it = names.find(leaf_name); it != names.end()) {
-                std::map<std::string, int64_t> fields =
-                        get_enum_single(type_record, GetLeafSize(
-                                static_cast<PDB::CodeView::TPI::TypeRecordKind>(
-                                        record->data.LF_ENUM.utype)), it->second);
-                result.insert({it->first, fields});
-            }
-        }
+        collect_enum(tpi_stream, record, names, result);
     }
 
-    for (const auto &[name, fields]: names) {
-        if (result.find(name) == result.end()) {
-            std::map<std::string, int64_t> empty_fields;
-            for (const auto &field: fields) {
-                empty_fields.insert({field, -1});
-            }
-            result.insert({name, empty_fields});
+    return result;
+}
+
+void pdb_parser::collect_enum(
+        const PDB::TPIStream &tpi_stream,
+        const PDB::CodeView::TPI::Record *record,
+        const member_set &names,
+        enum_result &result
+) {
+    if (record->header.kind == PDB::CodeView::TPI::TypeRecordKind::LF_ENUM) {
+        if (record->data.LF_ENUM.property.fwdref)
+            return;
+
+        auto type_record = tpi_stream.GetTypeRecord(record->data.LF_ENUM.field);
+        if (!type_record)
+            return;
+
+        auto leaf_name = record->data.LF_ENUM.name;
+        const member_set::entry *entry = names.find(leaf_name);
+        if (entry && !result.found[names.index(*entry)]) {
+            result.found[names.index(*entry)] = true;
+            get_enum_single(type_record, GetLeafSize(
+                    static_cast<PDB::CodeView::TPI::TypeRecordKind>(
+                            record->data.LF_ENUM.utype)), entry->members,
+                            result.values.data() + entry->first);
         }
     }
-    return result;
 }
 
-std::map<std::string, int64_t>
+void
 pdb_parser::get_enum_single(
         const PDB::CodeView::TPI::Record *record,
         uint8_t underlying_type_size,
-        const std::set<std::string> &names
+        const name_set &names,
+        int64_t *values
 ) {
-    std::map<std::string, int64_t> result;
-
     const char *leaf_name = nullptr;
     uint64_t value = 0;
     const char *value_ptr = nullptr;
@@ -461,8 +510,9 @@ pdb_parser::get_enum_single(
                 break;
         }
 
-        if (names.find(leaf_name) != names.end()) {
-            result.insert({leaf_name, value});
+        size_t index = names.index(leaf_name);
+        if (index != names.size()) {
+            values[index] = static_cast<int64_t>(value);
         }
 
         i += static_cast<size_t>(leaf_name - reinterpret_cast<const char *>(field_record));
@@ -471,10 +521,26 @@ pdb_parser::get_enum_single(
 
         (void) value_ptr;
     }
+}
+
+pdb_query_result pdb_parser::query_impl(
+        const PDB::RawFile &raw_file,
+        const PDB::DBIStream &dbi_stream,
+        const PDB::TPIStream &tpi_stream,
+        const pdb_query &q,
+        std::pmr::memory_resource *memory
+) {
+    pdb_query_result result(q, memory);
+
+    // the symbol streams are only walked when symbols are asked for
+    if (!q.symbols.empty()) {
+        result.symbols = get_symbols_impl(raw_file, dbi_stream, tpi_stream, q.symbols, memory);
+    }
 
-    for (const std::string &name: names) {
-        if (result.find(name) == result.end()) {
-            result.insert({name, -1});
+    if (!q.structs.empty() || !q.enums.empty()) {
+        for (const auto &record: tpi_stream.GetTypeRecords()) {
+            collect_struct(tpi_stream, record, q.structs, result.structs);
+            collect_enum(tpi_stream, record, q.enums, result.enums);
         }
     }
 
@@ -503,3 +569,25 @@ pdb_stats pdb_parser::get_stats_impl(
 
     return stats;
 }
+
+pdb_info pdb_parser::get_info_impl(
+        const PDB::RawFile &raw_file,
+        const PDB::DBIStream &/*dbi_stream*/,
+        const PDB::TPIStream &/*tpi_stream*/
+) {
+    const PDB::InfoStream info_stream(raw_file);
+    const PDB::Header *header = info_stream.GetHeader();
+
+    // same format as the symbol server key, e.g. "8F0F3D677778391600F4EB2301FFC7A5"
+    char guid[33];
+    snprintf(guid, sizeof(guid), "%08X%04X%04X%02X%02X%02X%02X%02X%02X%02X%02X",
+             header->guid.Data1, header->guid.Data2, header->guid.Data3,
+             header->guid.Data4[0], header->guid.Data4[1], header->guid.Data4[2],
+             header->guid.Data4[3], header->guid.Data4[4], header->guid.Data4[5],
+             header->guid.Data4[6], header->guid.Data4[7]);
+
+    pdb_info info{};
+    info.guid = guid;
+    info.age = header->age;
+    return info;
+}
@@ -3,27 +3,72 @@
 
 #include <string>
 #include <memory>
-#include <set>
-#include <map>
+#include <memory_resource>
+#include <vector>
 #include <PDB.h>
 #include <PDB_RawFile.h>
 #include <PDB_InfoStream.h>
 #include <PDB_DBIStream.h>
 #include <PDB_TPIStream.h>
 #include "handle_guard.h"
+#include "query_names.h"
 
 struct field_info {
     int64_t offset;
     int64_t bitfield_offset;
 
     field_info() : offset(-1), bitfield_offset(0) {}
+};
 
-    std::map<std::string, int64_t> to_map() const {
-        return {
-                {"offset",          offset},
-                {"bitfield_offset", bitfield_offset}
-        };
-    }
+// symbols, structs and enums of one pdb, resolved together by pdb_parser::query.
+// the names are views into the decoded request (see request_reader.h)
+struct pdb_query {
+    name_set symbols;
+    member_set structs;
+    member_set enums;
+
+    explicit pdb_query(std::pmr::memory_resource *memory = std::pmr::get_default_resource())
+            : symbols(memory),
+              structs(memory),
+              enums(memory) {}
+};
+
+// results are flat arrays in the order of the sorted names they answer, names that
+// are not found keep offset -1 / value -1. they are allocated from the memory passed
+// to the parser, usually the arena of the request
+
+// the RVA of every name of the name_set
+using symbol_result = std::pmr::vector<int64_t>;
+
+// fields[entry.first + i] belongs to the i-th member of a member_set entry,
+// found[member_set::index(entry)] is set once the type is found, its first definition wins
+struct struct_result {
+    std::pmr::vector<field_info> fields;
+    std::pmr::vector<bool> found;
+
+    struct_result(const member_set &names, std::pmr::memory_resource *memory)
+            : fields(names.member_count(), memory),
+              found(names.type_count(), false, memory) {}
+};
+
+struct enum_result {
+    std::pmr::vector<int64_t> values;
+    std::pmr::vector<bool> found;
+
+    enum_result(const member_set &names, std::pmr::memory_resource *memory)
+            : values(names.member_count(), -1, memory),
+              found(names.type_count(), false, memory) {}
+};
+
+struct pdb_query_result {
+    symbol_result symbols;
+    struct_result structs;
+    enum_result enums;
+
+    pdb_query_result(const pdb_query &q, std::pmr::memory_resource *memory)
+            : symbols(q.symbols.size(), -1, memory),
+              structs(q.structs, memory),
+              enums(q.enums, memory) {}
 };
 
 struct pdb_stats {
@@ -32,58 +77,106 @@ struct pdb_stats {
     size_t type_count;
 };
 
+struct pdb_info {
+    std::string guid;
+    uint32_t age;
+};
+
 class pdb_parser {
 public:
     explicit pdb_parser(const std::string &filename);
 
-    std::map<std::string, int64_t> get_symbols(const std::set<std::string> &names) const;
+    symbol_result get_symbols(const name_set &names, std::pmr::memory_resource *memory) const;
 
-    std::map<std::string, std::map<std::string, field_info>>
-    get_struct(const std::map<std::string, std::set<std::string>> &names) const;
+    struct_result get_struct(const member_set &names, std::pmr::memory_resource *memory) const;
 
-    std::map<std::string, std::map<std::string, int64_t>>
-    get_enum(const std::map<std::string, std::set<std::string>> &names) const;
+    enum_result get_enum(const member_set &names, std::pmr::memory_resource *memory) const;
+
+    // structs and enums share a single pass over the TPI stream
+    pdb_query_result query(const pdb_query &q, std::pmr::memory_resource *memory) const;
 
     pdb_stats get_stats();
 
+    pdb_info get_info();
+
+    // drops the pages of the mapped file from the process (linux only). the file backs
+    // them, queries running meanwhile read them in again. this lowers the rss, the
+    // pages stay in the page cache and charged to the cgroup until the kernel reclaims
+    // them, which it does earlier for pages no process maps
+    void release_pages() const;
+
 private:
+    // the streams are validated and created once, a parser can then be
+    // shared by any number of requests (see pdb_cache)
     handle_guard file_{};
+    PDB::RawFile raw_file_;
+    PDB::DBIStream dbi_stream_;
+    PDB::TPIStream tpi_stream_;
+
+    static const void *validate_file(const handle_guard &file);
 
-    static std::map<std::string, int64_t> get_symbols_impl(
+    static symbol_result get_symbols_impl(
             const PDB::RawFile &raw_file,
             const PDB::DBIStream &dbi_stream,
             const PDB::TPIStream &tpi_stream,
-            const std::set<std::string> &names
+            const name_set &names,
+            std::pmr::memory_resource *memory
     );
 
-    static std::map<std::string, std::map<std::string, field_info>>
+    static struct_result
     get_struct_impl(
             const PDB::RawFile &raw_file,
             const PDB::DBIStream &dbi_stream,
             const PDB::TPIStream &tpi_stream,
-            const std::map<std::string, std::set<std::string>> &names
+            const member_set &names,
+            std::pmr::memory_resource *memory
     );
 
-    static std::map<std::string, field_info>
+    static void collect_struct(
+            const PDB::TPIStream &tpi_stream,
+            const PDB::CodeView::TPI::Record *record,
+            const member_set &names,
+            struct_result &result
+    );
+
+    static void
     get_struct_single(
             const PDB::TPIStream &tpi_stream,
             const PDB::CodeView::TPI::Record *record,
-            const std::set<std::string> &names
+            const name_set &names,
+            field_info *fields
     );
 
-    static std::map<std::string, std::map<std::string, int64_t>>
+    static enum_result
     get_enum_impl(
             const PDB::RawFile &raw_file,
             const PDB::DBIStream &dbi_stream,
             const PDB::TPIStream &tpi_stream,
-            const std::map<std::string, std::set<std::string>> &names
+            const member_set &names,
+            std::pmr::memory_resource *memory
     );
 
-    static std::map<std::string, int64_t>
+    static void collect_enum(
+            const PDB::TPIStream &tpi_stream,
+            const PDB::CodeView::TPI::Record *record,
+            const member_set &names,
+            enum_result &result
+    );
+
+    static void
     get_enum_single(
             const PDB::CodeView::TPI::Record *record,
             uint8_t underlying_type_size,
-            const std::set<std::string> &names
+            const name_set &names,
+            int64_t *values
+    );
+
+    static pdb_query_result query_impl(
+            const PDB::RawFile &raw_file,
+            const PDB::DBIStream &dbi_stream,
+            const PDB::TPIStream &tpi_stream,
+            const pdb_query &q,
+            std::pmr::memory_resource *memory
     );
 
     static pdb_stats get_stats_impl(
@@ -92,38 +185,15 @@ private:
             const PDB::TPIStream &tpi_stream
     );
 
+    static pdb_info get_info_impl(
+            const PDB::RawFile &raw_file,
+            const PDB::DBIStream &dbi_stream,
+            const PDB::TPIStream &tpi_stream
+    );
+
     template<typename F, typename ...Args>
     auto call_with_pdb_stream(F f, Args &&...args) const {
-        // sanity check
-        if (!file_.get().baseAddress ||
-            PDB::ValidateFile(file_.get().baseAddress) != PDB::ErrorCode::Success) {
-            throw std::runtime_error("invalid PDB file");
-        }
-
-        const PDB::RawFile raw_file = PDB::CreateRawFile(file_.get().baseAddress);
-        if (PDB::HasValidDBIStream(raw_file) != PDB::ErrorCode::Success) {
-            throw std::runtime_error("invalid DBI stream");
-        }
-
-        const PDB::InfoStream info_stream(raw_file);
-        if (info_stream.UsesDebugFastLink()) {
-            throw std::runtime_error("invalid info stream");
-        }
-
-        const PDB::DBIStream dbi_stream = PDB::CreateDBIStream(raw_file);
-        if (dbi_stream.HasValidImageSectionStream(raw_file) != PDB::ErrorCode::Success ||
-            dbi_stream.HasValidPublicSymbolStream(raw_file) != PDB::ErrorCode::Success ||
-            dbi_stream.HasValidGlobalSymbolStream(raw_file) != PDB::ErrorCode::Success ||
-            dbi_stream.HasValidSectionContributionStream(raw_file) != PDB::ErrorCode::Success) {
-            throw std::runtime_error("invalid DBI streams");
-        }
-
-        const PDB::TPIStream tpi_stream = PDB::CreateTPIStream(raw_file);
-        if (PDB::HasValidTPIStream(raw_file) != PDB::ErrorCode::Success) {
-            throw std::runtime_error("invalid TPI stream");
-        }
-
-        return f(raw_file, dbi_stream, tpi_stream, std::forward<Args>(args)...);
+        return f(raw_file_, dbi_stream_, tpi_stream_, std::forward<Args>(args)...);
     }
 
 };
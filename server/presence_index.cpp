@@ -0,0 +1,210 @@
+#include <mutex>
+#include <algorithm>
+#include <cctype>
+#include <spdlog/spdlog.h>
+#ifdef __linux__
+#include <poll.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+#endif
+#include "presence_index.h"
+
+presence_index::presence_index(std::filesystem::path root)
+        : root_(std::move(root)),
+          inotify_fd_(-1),
+          stop_(false) {}
+
+presence_index::~presence_index() {
+    stop_ = true;
+    if (watch_thread_.joinable()) {
+        watch_thread_.join();
+    }
+#ifdef __linux__
+    if (inotify_fd_ != -1) {
+        close(inotify_fd_);
+    }
+#endif
+}
+
+size_t presence_index::load() {
+    size_t count = 0;
+    std::error_code ec;
+    for (auto it = std::filesystem::recursive_directory_iterator(root_, ec);
+         !ec && it != std::filesystem::recursive_directory_iterator(); it.increment(ec)) {
+        // the object store is not part of the key layout
+        if (it.depth() == 0 && it->path().filename() == ".objects") {
+            it.disable_recursion_pending();
+            continue;
+        }
+        std::error_code entry_ec;
+        if (it.depth() == 2 && it->is_regular_file(entry_ec) && add_file(it->path())) {
+            count++;
+        }
+    }
+    return count;
+}
+
+bool presence_index::find(const std::string &name, const std::string &guid, uint32_t age,
+                          pdb_location &location) const {
+    std::shared_lock lock(mutex_);
+    auto it = entries_.find(key{name, guid, age});
+    if (it == entries_.end()) {
+        return false;
+    }
+    location = it->second;
+    return true;
+}
+
+void presence_index::insert(const std::string &name, const std::string &guid, uint32_t age,
+                            const std::filesystem::path &path) {
+    pdb_location location{path, {}};
+    if (!get_file_id(path, location.id)) {
+        return;
+    }
+
+    std::unique_lock lock(mutex_);
+    entries_[key{name, guid, age}] = std::move(location);
+}
+
+void presence_index::remove(const std::string &name, const std::string &guid, uint32_t age) {
+    std::unique_lock lock(mutex_);
+    entries_.erase(key{name, guid, age});
+}
+
+bool presence_index::parse_key(const std::filesystem::path &path, key &k) const {
+    auto relative = path.lexically_relative(root_);
+    auto it = relative.begin();
+    std::string parts[3];
+    for (auto &part: parts) {
+        if (it == relative.end()) {
+            return false;
+        }
+        part = (it++)->string();
+    }
+    if (it != relative.end() || parts[0] != parts[2]) {
+        return false;
+    }
+
+    // 32 hex digits of guid followed by the age in hex
+    const std::string &dir = parts[1];
+    if (dir.size() <= 32 || dir.size() > 40 ||
+        !std::all_of(dir.begin(), dir.end(), [](char c) { return isxdigit(c); })) {
+        return false;
+    }
+
+    k.name = parts[0];
+    k.guid = dir.substr(0, 32);
+    k.age = static_cast<uint32_t>(std::stoul(dir.substr(32), nullptr, 16));
+    return true;
+}
+
+bool presence_index::add_file(const std::filesystem::path &path) {
+    key k;
+    if (!parse_key(path, k)) {
+        return false;
+    }
+    insert(k.name, k.guid, k.age, path);
+    return true;
+}
+
+void presence_index::remove_file(const std::filesystem::path &path) {
+    key k;
+    if (!parse_key(path, k)) {
+        return;
+    }
+
+    remove(k.name, k.guid, k.age);
+}
+
+bool presence_index::watch() {
+#ifdef __linux__
+    inotify_fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotify_fd_ == -1) {
+        spdlog::error("failed to initialize inotify");
+        return false;
+    }
+
+    // files added between load() and here are picked up by the scan in watch_directory
+    watch_directory(root_);
+    watch_thread_ = std::thread(&presence_index::watch_loop, this);
+    return true;
+#else
+    return false;
+#endif
+}
+
+void presence_index::watch_directory(const std::filesystem::path &dir) {
+#ifdef __linux__
+    auto relative = dir.lexically_relative(root_);
+    size_t depth = relative == "." ? 0 : std::distance(relative.begin(), relative.end());
+    if (depth > 2 || (depth == 1 && dir.filename() == ".objects")) {
+        return;
+    }
+
+    int wd = inotify_add_watch(inotify_fd_, dir.c_str(),
+                               IN_CREATE | IN_MOVED_TO | IN_CLOSE_WRITE |
+                               IN_DELETE | IN_MOVED_FROM | IN_ONLYDIR);
+    if (wd == -1) {
+        spdlog::warn("failed to watch directory, path: {}", dir.string());
+        return;
+    }
+    watches_[wd] = dir;
+
+    std::error_code ec;
+    for (auto it = std::filesystem::directory_iterator(dir, ec);
+         !ec && it != std::filesystem::directory_iterator(); it.increment(ec)) {
+        std::error_code entry_ec;
+        if (it->is_directory(entry_ec)) {
+            watch_directory(it->path());
+        } else if (depth == 2 && it->is_regular_file(entry_ec)) {
+            add_file(it->path());
+        }
+    }
+#else
+    (void) dir;
+#endif
+}
+
+void presence_index::watch_loop() {
+#ifdef __linux__
+    alignas(inotify_event) char buf[4096];
+
+    while (!stop_) {
+        pollfd pfd{inotify_fd_, POLLIN, 0};
+        if (poll(&pfd, 1, 500) <= 0) {
+            continue;
+        }
+
+        ssize_t len = read(inotify_fd_, buf, sizeof(buf));
+        for (ssize_t i = 0; i < len;) {
+            auto event = reinterpret_cast<const inotify_event *>(buf + i);
+            i += static_cast<ssize_t>(sizeof(inotify_event) + event->len);
+
+            auto it = watches_.find(event->wd);
+            if (it == watches_.end()) {
+                continue;
+            }
+            if (event->mask & IN_IGNORED) {
+                watches_.erase(it);
+                continue;
+            }
+            if (event->len == 0) {
+                continue;
+            }
+
+            auto path = std::filesystem::path(it->second).append(event->name);
+            if (event->mask & IN_ISDIR) {
+                if (event->mask & (IN_CREATE | IN_MOVED_TO)) {
+                    watch_directory(path);
+                }
+            } else if (event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO)) {
+                if (add_file(path)) {
+                    spdlog::info("pdb added externally, path: {}", path.string());
+                }
+            } else if (event->mask & (IN_DELETE | IN_MOVED_FROM)) {
+                remove_file(path);
+            }
+        }
+    }
+#endif
+}
@@ -0,0 +1,86 @@
+#ifndef QUERY_PDB_SERVER_PRESENCE_INDEX_H
+#define QUERY_PDB_SERVER_PRESENCE_INDEX_H
+
+#include <map>
+#include <string>
+#include <thread>
+#include <atomic>
+#include <shared_mutex>
+#include <unordered_map>
+#include <filesystem>
+#include "file_util.h"
+
+struct pdb_location {
+    std::filesystem::path path;
+    file_id id;
+};
+
+// in-memory set of the pdb files in the download path, so a warm
+// request neither builds the path nor touches the file system.
+// it is loaded once at startup, kept current by the downloader and
+// optionally (linux only) by watching the directory for files added
+// or removed by external tools
+class presence_index {
+public:
+    explicit presence_index(std::filesystem::path root);
+
+    ~presence_index();
+
+    size_t load();
+
+    bool find(const std::string &name, const std::string &guid, uint32_t age,
+              pdb_location &location) const;
+
+    void insert(const std::string &name, const std::string &guid, uint32_t age,
+                const std::filesystem::path &path);
+
+    void remove(const std::string &name, const std::string &guid, uint32_t age);
+
+    bool watch();
+
+    presence_index(const presence_index &) = delete;
+
+    presence_index &operator=(const presence_index &) = delete;
+
+private:
+    struct key {
+        std::string name;
+        std::string guid;
+        uint32_t age;
+
+        bool operator==(const key &other) const {
+            return age == other.age && name == other.name && guid == other.guid;
+        }
+    };
+
+    struct key_hash {
+        size_t operator()(const key &k) const {
+            size_t h = std::hash<std::string>()(k.name);
+            h = h * 31 + std::hash<std::string>()(k.guid);
+            return h * 31 + k.age;
+        }
+    };
+
+    std::filesystem::path root_;
+    mutable std::shared_mutex mutex_;
+    std::unordered_map<key, pdb_location, key_hash> entries_;
+
+    int inotify_fd_;
+    std::atomic<bool> stop_;
+    std::thread watch_thread_;
+    // watch descriptor -> directory, only used by the watch thread
+    std::map<int, std::filesystem::path> watches_;
+
+    // "name/GUIDAGE/name" relative to root, see downloader::get_relative_path_str
+    bool parse_key(const std::filesystem::path &path, key &k) const;
+
+    bool add_file(const std::filesystem::path &path);
+
+    void remove_file(const std::filesystem::path &path);
+
+    void watch_directory(const std::filesystem::path &dir);
+
+    void watch_loop();
+};
+
+#endif //QUERY_PDB_SERVER_PRESENCE_INDEX_H
@@ -0,0 +1,76 @@
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include "query_names.h"
+
+name_buffer::name_buffer(size_t capacity, std::pmr::memory_resource *memory)
+        : data_(static_cast<char *>(memory->allocate(capacity + 1, 1))),
+          size_(0),
+          capacity_(capacity + 1) {}
+
+std::string_view name_buffer::add(std::string_view name) {
+    if (capacity_ - size_ < name.size() + 1) {
+        throw std::runtime_error("request names exceed the request size");
+    }
+
+    char *start = data_ + size_;
+    memcpy(start, name.data(), name.size());
+    start[name.size()] = '\0';
+    size_ += name.size() + 1;
+    return {start, name.size()};
+}
+
+name_set::name_set(std::pmr::vector<std::string_view> names)
+        : names_(std::move(names)) {
+    std::sort(names_.begin(), names_.end());
+    names_.erase(std::unique(names_.begin(), names_.end()), names_.end());
+}
+
+bool name_set::contains(std::string_view name) const {
+    return std::binary_search(names_.begin(), names_.end(), name);
+}
+
+size_t name_set::index(std::string_view name) const {
+    auto it = std::lower_bound(names_.begin(), names_.end(), name);
+    if (it == names_.end() || *it != name) {
+        return names_.size();
+    }
+    return static_cast<size_t>(it - names_.begin());
+}
+
+member_set::member_set(const type_list &list)
+        : types_(list.types.get_allocator()) {
+    std::pmr::memory_resource *memory = list.types.get_allocator().resource();
+    std::pmr::vector<std::string_view> types(list.types, memory);
+    std::sort(types.begin(), types.end());
+    types.erase(std::unique(types.begin(), types.end()), types.end());
+
+    std::pmr::vector<std::pair<std::string_view, std::string_view>> members(list.members, memory);
+    std::sort(members.begin(), members.end());
+
+    // members are grouped by type after sorting, hand each group to its type
+    types_.reserve(types.size());
+    auto it = members.begin();
+    for (auto type: types) {
+        it = std::lower_bound(it, members.end(), type, [](const auto &member, std::string_view name) {
+            return member.first < name;
+        });
+        std::pmr::vector<std::string_view> names(memory);
+        for (; it != members.end() && it->first == type; ++it) {
+            names.push_back(it->second);
+        }
+        types_.push_back({type, name_set(std::move(names)), member_count_});
+        member_count_ += types_.back().members.size();
+    }
+}
+
+const member_set::entry *member_set::find(std::string_view type) const {
+    auto it = std::lower_bound(types_.begin(), types_.end(), type,
+                               [](const entry &e, std::string_view name) {
+                                   return e.type < name;
+                               });
+    if (it == types_.end() || it->type != type) {
+        return nullptr;
+    }
+    return &*it;
+}
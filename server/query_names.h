@@ -0,0 +1,119 @@
+#ifndef QUERY_PDB_SERVER_QUERY_NAMES_H
+#define QUERY_PDB_SERVER_QUERY_NAMES_H
+
+#include <memory_resource>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// one allocation for all names of a request. the capacity is fixed up front (decoded
+// names are never longer than the raw request), it never grows, so the views it hands
+// out stay valid. the memory is taken from a request_arena and is never given back
+// on its own, it goes with the arena. every name is followed by a '\0'
+class name_buffer {
+public:
+    name_buffer(size_t capacity, std::pmr::memory_resource *memory);
+
+    std::string_view add(std::string_view name);
+
+private:
+    char *data_;
+    size_t size_;
+    size_t capacity_;
+};
+
+// requested members in request order, a type is listed even if it has no members
+struct type_list {
+    std::pmr::vector<std::string_view> types;
+    std::pmr::vector<std::pair<std::string_view, std::string_view>> members;
+
+    explicit type_list(std::pmr::memory_resource *memory = std::pmr::get_default_resource())
+            : types(memory),
+              members(memory) {}
+};
+
+// sorted names without duplicates, looked up by binary search
+class name_set {
+public:
+    explicit name_set(std::pmr::memory_resource *memory = std::pmr::get_default_resource())
+            : names_(memory) {}
+
+    // sorts names in place, in the memory they already use
+    explicit name_set(std::pmr::vector<std::string_view> names);
+
+    bool contains(std::string_view name) const;
+
+    // position of name in the sorted set, size() if it is not in the set
+    size_t index(std::string_view name) const;
+
+    bool empty() const {
+        return names_.empty();
+    }
+
+    size_t size() const {
+        return names_.size();
+    }
+
+    auto begin() const {
+        return names_.begin();
+    }
+
+    auto end() const {
+        return names_.end();
+    }
+
+private:
+    std::pmr::vector<std::string_view> names_;
+};
+
+// the requested members of every type, sorted by type name. the members of all types
+// are numbered in that order, so results can be kept in one flat array
+class member_set {
+public:
+    struct entry {
+        std::string_view type;
+        name_set members;
+        // number of the first member
+        size_t first;
+    };
+
+    explicit member_set(std::pmr::memory_resource *memory = std::pmr::get_default_resource())
+            : types_(memory) {}
+
+    // allocates from the same memory as list
+    explicit member_set(const type_list &list);
+
+    // nullptr if the type is not requested
+    const entry *find(std::string_view type) const;
+
+    // position of the entry in the sorted types
+    size_t index(const entry &e) const {
+        return static_cast<size_t>(&e - types_.data());
+    }
+
+    size_t type_count() const {
+        return types_.size();
+    }
+
+    size_t member_count() const {
+        return member_count_;
+    }
+
+    bool empty() const {
+        return types_.empty();
+    }
+
+    auto begin() const {
+        return types_.begin();
+    }
+
+    auto end() const {
+        return types_.end();
+    }
+
+private:
+    std::pmr::vector<entry> types_;
+    size_t member_count_ = 0;
+};
+
+#endif //QUERY_PDB_SERVER_QUERY_NAMES_H
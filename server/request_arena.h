@@ -0,0 +1,24 @@
+#ifndef QUERY_PDB_SERVER_REQUEST_ARENA_H
+#define QUERY_PDB_SERVER_REQUEST_ARENA_H
+
+#include <cstddef>
+#include <memory_resource>
+
+// memory for everything one request allocates (decoded names, name sets, results),
+// given back in one step when the arena goes out of scope. small requests are served
+// from the inline buffer, larger ones take a few growing blocks from the heap.
+// not thread safe: a request resolved on several threads needs one arena per thread
+class request_arena : public std::pmr::monotonic_buffer_resource {
+public:
+    request_arena()
+            : std::pmr::monotonic_buffer_resource(buffer_, sizeof(buffer_)) {}
+
+    request_arena(const request_arena &) = delete;
+
+    request_arena &operator=(const request_arena &) = delete;
+
+private:
+    alignas(std::max_align_t) std::byte buffer_[8192];
+};
+
+#endif //QUERY_PDB_SERVER_REQUEST_ARENA_H
@@ -0,0 +1,36 @@
+#include <spdlog/spdlog.h>
+#include "request_coalescer.h"
+
+std::shared_ptr<const stored_response>
+request_coalescer::run(const std::string &key,
+                       const std::function<std::shared_ptr<const stored_response>()> &compute) {
+    std::promise<std::shared_ptr<const stored_response>> promise;
+    result future;
+    {
+        std::lock_guard lock(mutex_);
+        if (auto it = inflight_.find(key); it != inflight_.end()) {
+            future = it->second;
+        } else {
+            inflight_.emplace(key, promise.get_future().share());
+        }
+    }
+    if (future.valid()) {
+        spdlog::debug("coalesce request with the one in flight");
+        return future.get();
+    }
+
+    try {
+        promise.set_value(compute());
+    } catch (...) {
+        promise.set_exception(std::current_exception());
+    }
+
+    {
+        // later requests find the response in the response cache
+        std::lock_guard lock(mutex_);
+        auto it = inflight_.find(key);
+        future = it->second;
+        inflight_.erase(it);
+    }
+    return future.get();
+}
@@ -0,0 +1,29 @@
+#ifndef QUERY_PDB_SERVER_REQUEST_COALESCER_H
+#define QUERY_PDB_SERVER_REQUEST_COALESCER_H
+
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include "response_cache.h"
+
+// identical requests arriving while the first one is still being answered
+// (e.g. hundreds of agents after a new windows build) wait for its response
+// instead of downloading and parsing the same pdb again
+class request_coalescer {
+public:
+    // call compute, or wait for the running call with the same key and share
+    // its response. an exception thrown by compute is rethrown to every caller
+    std::shared_ptr<const stored_response>
+    run(const std::string &key, const std::function<std::shared_ptr<const stored_response>()> &compute);
+
+private:
+    using result = std::shared_future<std::shared_ptr<const stored_response>>;
+
+    std::mutex mutex_;
+    std::unordered_map<std::string, result> inflight_;
+};
+
+#endif //QUERY_PDB_SERVER_REQUEST_COALESCER_H
@@ -0,0 +1,290 @@
+#include <limits>
+#include <stdexcept>
+#include <nlohmann/json.hpp>
+#include "request_reader.h"
+
+namespace {
+
+    enum class body_kind {
+        single,
+        query,
+        batch,
+    };
+
+    enum class request_field {
+        ignored,
+        name,
+        guid,
+        age,
+        symbols,
+        structs,
+        enums,
+    };
+
+    // sax handler, fills pdb_request straight from the json tokens without building a dom.
+    // depth_ counts the open containers, the fields of a request are at request_depth_
+    // (the root object, or an object in the root array of a batch)
+    class request_handler {
+    public:
+        using json = nlohmann::json;
+
+        std::pmr::vector<pdb_request> requests;
+
+        request_handler(const std::string &body, body_kind kind, query_part part,
+                        std::pmr::memory_resource *memory)
+                : requests(memory),
+                  names_(body.size(), memory),
+                  kind_(kind),
+                  part_(part),
+                  request_depth_(kind == body_kind::batch ? 2 : 1) {}
+
+        bool null() {
+            unexpected();
+            return true;
+        }
+
+        bool boolean(bool) {
+            unexpected();
+            return true;
+        }
+
+        bool number_integer(json::number_integer_t) {
+            unexpected();
+            return true;
+        }
+
+        bool number_unsigned(json::number_unsigned_t value) {
+            if (depth_ == request_depth_ && field_ == request_field::age &&
+                value <= std::numeric_limits<uint32_t>::max()) {
+                requests.back().age = static_cast<uint32_t>(value);
+                has_age_ = true;
+            } else {
+                unexpected();
+            }
+            return true;
+        }
+
+        bool number_float(json::number_float_t, const json::string_t &) {
+            unexpected();
+            return true;
+        }
+
+        bool binary(json::binary_t &) {
+            unexpected();
+            return true;
+        }
+
+        bool string(json::string_t &value) {
+            if (depth_ == request_depth_ && field_ == request_field::name) {
+                requests.back().name = value;
+                has_name_ = true;
+            } else if (depth_ == request_depth_ && field_ == request_field::guid) {
+                requests.back().guid = value;
+                has_guid_ = true;
+            } else if (depth_ == request_depth_ + 1 && field_ == request_field::symbols) {
+                requests.back().symbols.push_back(names_.add(value));
+            } else if (depth_ == request_depth_ + 2 && is_type_field()) {
+                get_types().members.emplace_back(type_, names_.add(value));
+            } else {
+                unexpected();
+            }
+            return true;
+        }
+
+        bool start_object(std::size_t) {
+            if (depth_ + 1 == request_depth_) {
+                begin_request();
+            } else if (depth_ == request_depth_ && field_ == request_field::structs) {
+                requests.back().has_structs = true;
+            } else if (depth_ == request_depth_ && field_ == request_field::enums) {
+                requests.back().has_enums = true;
+            } else {
+                unexpected();
+            }
+            depth_++;
+            return true;
+        }
+
+        bool key(json::string_t &value) {
+            if (depth_ == request_depth_) {
+                field_ = get_field(value);
+                field_name_ = value;
+            } else if (depth_ == request_depth_ + 1 && is_type_field()) {
+                type_ = names_.add(value);
+                get_types().types.push_back(type_);
+            }
+            return true;
+        }
+
+        bool end_object() {
+            depth_--;
+            if (depth_ + 1 == request_depth_) {
+                end_request();
+            }
+            return true;
+        }
+
+        bool start_array(std::size_t) {
+            if (depth_ == 0 && kind_ == body_kind::batch) {
+                // the root of a batch
+            } else if (depth_ == request_depth_ && field_ == request_field::symbols) {
+                requests.back().has_symbols = true;
+            } else if (depth_ == request_depth_ + 1 && is_type_field()) {
+                // the members of type_
+            } else {
+                unexpected();
+            }
+            depth_++;
+            return true;
+        }
+
+        bool end_array() {
+            depth_--;
+            return true;
+        }
+
+        bool parse_error(std::size_t, const std::string &, const nlohmann::detail::exception &e) {
+            throw std::runtime_error(e.what());
+        }
+
+    private:
+        name_buffer names_;
+        body_kind kind_;
+        query_part part_;
+        size_t request_depth_;
+        size_t depth_ = 0;
+
+        // state of the request being read
+        request_field field_ = request_field::ignored;
+        std::string field_name_;
+        std::string_view type_;
+        bool has_name_ = false;
+        bool has_guid_ = false;
+        bool has_age_ = false;
+
+        request_field get_field(const std::string &key) const {
+            if (key == "name") {
+                return request_field::name;
+            }
+            if (key == "guid") {
+                return request_field::guid;
+            }
+            if (key == "age") {
+                return request_field::age;
+            }
+            if (kind_ == body_kind::single) {
+                if (key != "query") {
+                    return request_field::ignored;
+                }
+                switch (part_) {
+                    case query_part::symbols:
+                        return request_field::symbols;
+                    case query_part::structs:
+                        return request_field::structs;
+                    default:
+                        return request_field::enums;
+                }
+            }
+            if (key == "symbol") {
+                return request_field::symbols;
+            }
+            if (key == "struct") {
+                return request_field::structs;
+            }
+            if (key == "enum") {
+                return request_field::enums;
+            }
+            return request_field::ignored;
+        }
+
+        bool is_type_field() const {
+            return field_ == request_field::structs || field_ == request_field::enums;
+        }
+
+        type_list &get_types() {
+            return field_ == request_field::structs ? requests.back().structs : requests.back().enums;
+        }
+
+        void begin_request() {
+            requests.emplace_back(requests.get_allocator().resource());
+            field_ = request_field::ignored;
+            has_name_ = false;
+            has_guid_ = false;
+            has_age_ = false;
+        }
+
+        void end_request() {
+            pdb_request &request = requests.back();
+            if (!has_name_) {
+                fail("missing field: name");
+            } else if (!has_guid_) {
+                fail("missing field: guid");
+            } else if (!has_age_) {
+                fail("missing field: age");
+            } else if (kind_ == body_kind::single &&
+                       !request.has_symbols && !request.has_structs && !request.has_enums) {
+                fail("missing field: query");
+            }
+
+            if (request.error.empty()) {
+                index_request(request);
+            }
+        }
+
+        void fail(const std::string &message) {
+            if (kind_ != body_kind::batch) {
+                throw std::runtime_error(message);
+            }
+
+            // the rest of the entry is skipped, the other entries are still read
+            if (requests.back().error.empty()) {
+                requests.back().error = message;
+            }
+            field_ = request_field::ignored;
+        }
+
+        // a value where the request has none, or of the wrong type.
+        // everything below unknown fields is skipped
+        void unexpected() {
+            if (depth_ == 0) {
+                throw std::runtime_error(kind_ == body_kind::batch ? "batch request must be an array"
+                                                                   : "request must be an object");
+            }
+            if (depth_ < request_depth_) {
+                begin_request();
+                fail("batch entry must be an object");
+                return;
+            }
+            if (field_ != request_field::ignored) {
+                fail("invalid field: " + field_name_);
+            }
+        }
+    };
+
+    std::pmr::vector<pdb_request> read_body(const std::string &body, body_kind kind, query_part part,
+                                            std::pmr::memory_resource *memory) {
+        request_handler handler(body, kind, part, memory);
+        nlohmann::json::sax_parse(body, &handler);
+        return std::move(handler.requests);
+    }
+
+}
+
+pdb_request read_request(const std::string &body, query_part part, std::pmr::memory_resource *memory) {
+    return std::move(read_body(body, body_kind::single, part, memory).front());
+}
+
+pdb_request read_query_request(const std::string &body, std::pmr::memory_resource *memory) {
+    return std::move(read_body(body, body_kind::query, query_part::symbols, memory).front());
+}
+
+std::pmr::vector<pdb_request> read_batch_request(const std::string &body, std::pmr::memory_resource *memory) {
+    return read_body(body, body_kind::batch, query_part::symbols, memory);
+}
+
+void index_request(pdb_request &request) {
+    // the sets are built in the request memory, moving them in keeps it
+    request.query.symbols = name_set(std::pmr::vector<std::string_view>(request.symbols, request.memory));
+    request.query.structs = member_set(request.structs);
+    request.query.enums = member_set(request.enums);
+}
@@ -0,0 +1,69 @@
+#ifndef QUERY_PDB_SERVER_REQUEST_READER_H
+#define QUERY_PDB_SERVER_REQUEST_READER_H
+
+#include <memory_resource>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "pdb_parser.h"
+#include "query_names.h"
+#include "work_pool.h"
+
+// where the names of a "query" field go, it depends on the endpoint
+enum class query_part {
+    symbols,
+    structs,
+    enums,
+};
+
+// a decoded /symbol, /struct, /enum or /query body. the names are views into one
+// buffer shared by every request of a body, kept in request order (the wire encoding
+// follows it) and as sorted sets in query (for the parser and the response key).
+// everything is allocated from memory, the arena of the http request
+struct pdb_request {
+    std::string name;
+    std::string guid;
+    uint32_t age = 0;
+
+    // which parts the request contains, a /query response only has those
+    bool has_symbols = false;
+    bool has_structs = false;
+    bool has_enums = false;
+
+    std::pmr::vector<std::string_view> symbols;
+    type_list structs;
+    type_list enums;
+    pdb_query query;
+
+    // a /batch entry that cannot be decoded, the other entries are still resolved
+    std::string error;
+
+    // how urgent answering it is, set by the http handler
+    work_priority priority = work_priority::interactive;
+
+    std::pmr::memory_resource *memory;
+
+    explicit pdb_request(std::pmr::memory_resource *memory)
+            : symbols(memory),
+              structs(memory),
+              enums(memory),
+              query(memory),
+              memory(memory) {}
+};
+
+// decode a /symbol, /struct or /enum body, its "query" field goes to part.
+// throws if the body is not valid json or misses a field
+pdb_request read_request(const std::string &body, query_part part, std::pmr::memory_resource *memory);
+
+// decode a /query body, "symbol", "struct" and "enum" are optional
+pdb_request read_query_request(const std::string &body, std::pmr::memory_resource *memory);
+
+// decode a /batch body, an array of /query bodies. throws if the body is not a json
+// array, an entry that is not a valid /query body gets its error set instead
+std::pmr::vector<pdb_request> read_batch_request(const std::string &body, std::pmr::memory_resource *memory);
+
+// sort the names of a request into request.query, done by the functions above
+// and needed once for requests that are filled in by hand
+void index_request(pdb_request &request);
+
+#endif //QUERY_PDB_SERVER_REQUEST_READER_H
@@ -0,0 +1,86 @@
+#include "response_cache.h"
+
+stored_response::stored_response(const httplib::Response &res)
+        : status(res.status),
+          body(res.body),
+          content_type(res.get_header_value("Content-Type")),
+          content_encoding(res.get_header_value("Content-Encoding")),
+          vary(res.get_header_value("Vary")) {}
+
+void stored_response::apply(httplib::Response &res) const {
+    if (status != -1) {
+        res.status = status;
+    }
+    if (!vary.empty()) {
+        res.set_header("Vary", vary);
+    }
+    if (!content_encoding.empty()) {
+        res.set_header("Content-Encoding", content_encoding);
+    }
+    res.set_content(body, content_type);
+}
+
+size_t stored_response::size() const {
+    return body.size() + content_type.size() + content_encoding.size() + vary.size();
+}
+
+response_cache::response_cache(size_t capacity)
+        : capacity_(capacity),
+          size_(0) {}
+
+std::shared_ptr<const stored_response> response_cache::find(const std::string &key) {
+    if (capacity_ == 0) {
+        return nullptr;
+    }
+
+    std::lock_guard lock(mutex_);
+    auto it = entries_.find(key);
+    if (it == entries_.end()) {
+        return nullptr;
+    }
+    lru_.splice(lru_.begin(), lru_, it->second);
+    return it->second->second;
+}
+
+void response_cache::insert(const std::string &key, std::shared_ptr<const stored_response> response) {
+    entry e{key, std::move(response)};
+    // a single response larger than the whole cache is not worth evicting everything
+    if (get_size(e) > capacity_) {
+        return;
+    }
+
+    std::lock_guard lock(mutex_);
+    if (entries_.find(key) != entries_.end()) {
+        // answered concurrently by another request
+        return;
+    }
+
+    size_ += get_size(e);
+    lru_.push_front(std::move(e));
+    entries_[key] = lru_.begin();
+    while (size_ > capacity_) {
+        size_ -= get_size(lru_.back());
+        entries_.erase(lru_.back().first);
+        lru_.pop_back();
+    }
+}
+
+size_t response_cache::clear() {
+    std::list<entry> dropped;
+    size_t size;
+    {
+        std::lock_guard lock(mutex_);
+        dropped.swap(lru_);
+        entries_.clear();
+        size = size_;
+        size_ = 0;
+    }
+    // the bodies are freed after the lock is released, a response still being
+    // sent keeps its own until it is done
+    return size;
+}
+
+size_t response_cache::get_size(const entry &e) {
+    // the key is stored twice, in the entry and in the map
+    return e.first.size() * 2 + e.second->size();
+}
@@ -0,0 +1,55 @@
+#ifndef QUERY_PDB_SERVER_RESPONSE_CACHE_H
+#define QUERY_PDB_SERVER_RESPONSE_CACHE_H
+
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <httplib.h>
+
+// a finished response, body already encoded and compressed
+struct stored_response {
+    int status;
+    std::string body;
+    std::string content_type;
+    std::string content_encoding;
+    std::string vary;
+
+    explicit stored_response(const httplib::Response &res);
+
+    void apply(httplib::Response &res) const;
+
+    size_t size() const;
+};
+
+// keeps the responses of recent requests.
+// a pdb never changes, so a hit is answered without downloading or parsing.
+// the key has to identify the request completely, including the negotiated
+// encoding and content coding (see get_response_key in main.cpp)
+class response_cache {
+public:
+    // capacity is the total size of the cached responses in bytes, 0 disables the cache
+    explicit response_cache(size_t capacity);
+
+    std::shared_ptr<const stored_response> find(const std::string &key);
+
+    void insert(const std::string &key, std::shared_ptr<const stored_response> response);
+
+    // drops every response, returns the bytes they took
+    size_t clear();
+
+private:
+    using entry = std::pair<std::string, std::shared_ptr<const stored_response>>;
+
+    size_t capacity_;
+    size_t size_;
+    std::mutex mutex_;
+    // most recently used first
+    std::list<entry> lru_;
+    std::unordered_map<std::string, std::list<entry>::iterator> entries_;
+
+    static size_t get_size(const entry &e);
+};
+
+#endif //QUERY_PDB_SERVER_RESPONSE_CACHE_H
@@ -0,0 +1,311 @@
+#include <cctype>
+#include <cstdlib>
+#include <utility>
+#include "compression.h"
+#include "response_encoding.h"
+#include "response_writer.h"
+#include <qpdb_wire.h>
+
+// little endian only, like every target of the clients
+static_assert(sizeof(qpdb_wire::header) == 16 && sizeof(qpdb_wire::record) == 24);
+
+// every thread encodes into one buffer that keeps its capacity from response to
+// response, only an unusually large one is given back
+static std::string &get_output_buffer() {
+    thread_local std::string buffer;
+    buffer.clear();
+    if (buffer.capacity() > 16 * 1024 * 1024) {
+        buffer.shrink_to_fit();
+    }
+    return buffer;
+}
+
+static response_writer::format get_writer_format(response_encoding encoding) {
+    switch (encoding) {
+        case response_encoding::msgpack:
+            return response_writer::format::msgpack;
+        case response_encoding::cbor:
+            return response_writer::format::cbor;
+        default:
+            return response_writer::format::json;
+    }
+}
+
+static void begin_wire(std::string &body, qpdb_wire::kind kind, size_t count) {
+    qpdb_wire::header header{qpdb_wire::magic, qpdb_wire::version, kind,
+                             static_cast<uint32_t>(count), 0};
+    body.reserve(sizeof(header) + count * sizeof(qpdb_wire::record));
+    body.append(reinterpret_cast<const char *>(&header), sizeof(header));
+}
+
+static void append_wire(std::string &body, uint64_t name_hash, int64_t offset, int64_t bitfield_offset) {
+    qpdb_wire::record record{name_hash, offset, bitfield_offset};
+    body.append(reinterpret_cast<const char *>(&record), sizeof(record));
+}
+
+// position of a member in the flat results, both come from the same request so it is found
+static size_t get_member_index(const member_set &names, std::string_view type, std::string_view member) {
+    const member_set::entry *entry = names.find(type);
+    return entry->first + entry->members.index(member);
+}
+
+static void write_symbols(response_writer &writer, const name_set &names, const symbol_result &result) {
+    writer.begin_object(names.size());
+    size_t index = 0;
+    for (std::string_view name: names) {
+        writer.key(name);
+        writer.value(result[index++]);
+    }
+    writer.end_object();
+}
+
+static void write_structs(response_writer &writer, const member_set &names, const struct_result &result) {
+    writer.begin_object(names.type_count());
+    for (const auto &entry: names) {
+        writer.key(entry.type);
+        writer.begin_object(entry.members.size());
+        size_t index = entry.first;
+        for (std::string_view name: entry.members) {
+            const field_info &field = result.fields[index++];
+            writer.key(name);
+            writer.begin_object(2);
+            writer.key("bitfield_offset");
+            writer.value(field.bitfield_offset);
+            writer.key("offset");
+            writer.value(field.offset);
+            writer.end_object();
+        }
+        writer.end_object();
+    }
+    writer.end_object();
+}
+
+static void write_enums(response_writer &writer, const member_set &names, const enum_result &result) {
+    writer.begin_object(names.type_count());
+    for (const auto &entry: names) {
+        writer.key(entry.type);
+        writer.begin_object(entry.members.size());
+        size_t index = entry.first;
+        for (std::string_view name: entry.members) {
+            writer.key(name);
+            writer.value(result.values[index++]);
+        }
+        writer.end_object();
+    }
+    writer.end_object();
+}
+
+// keys in sorted order: enum, struct, symbol
+static void write_query(response_writer &writer, const pdb_request &request, const pdb_query_result &result) {
+    writer.begin_object(request.has_symbols + request.has_structs + request.has_enums);
+    if (request.has_enums) {
+        writer.key("enum");
+        write_enums(writer, request.query.enums, result.enums);
+    }
+    if (request.has_structs) {
+        writer.key("struct");
+        write_structs(writer, request.query.structs, result.structs);
+    }
+    if (request.has_symbols) {
+        writer.key("symbol");
+        write_symbols(writer, request.query.symbols, result.symbols);
+    }
+    writer.end_object();
+}
+
+// q value of a media type in an Accept header, from the most specific range that
+// matches it ("type/subtype", then "type/*" and "*/*" when wildcards is set), -1 if
+// no range matches
+static double get_media_quality(const std::string &accept, const std::string &type, bool wildcards) {
+    const std::string family = type.substr(0, type.find('/')) + "/*";
+    double result = -1;
+    int specificity = 0;
+    size_t pos = 0;
+    while (pos < accept.size()) {
+        size_t end = accept.find(',', pos);
+        if (end == std::string::npos) {
+            end = accept.size();
+        }
+        std::string range = accept.substr(pos, end - pos);
+        pos = end + 1;
+
+        // "type/subtype;param=value;q=0.5"
+        double quality = 1;
+        size_t params = range.find(';');
+        for (size_t param = params; param != std::string::npos; param = range.find(';', param + 1)) {
+            size_t name = range.find_first_not_of(" \t", param + 1);
+            if (name != std::string::npos && range.compare(name, 2, "q=") == 0) {
+                quality = std::strtod(range.c_str() + name + 2, nullptr);
+            }
+        }
+        if (params != std::string::npos) {
+            range.erase(params);
+        }
+        range.erase(0, range.find_first_not_of(" \t"));
+        range.erase(range.find_last_not_of(" \t") + 1);
+        for (auto &c: range) {
+            c = static_cast<char>(tolower(static_cast<unsigned char>(c)));
+        }
+
+        int match = range == type ? 3 : wildcards && range == family ? 2 : wildcards && range == "*/*" ? 1 : 0;
+        if (match > specificity) {
+            specificity = match;
+            result = quality;
+        }
+    }
+    return result;
+}
+
+response_encoding negotiate_encoding(const httplib::Request &req) {
+    const std::string accept = req.get_header_value("Accept");
+    if (accept.empty()) {
+        return response_encoding::json;
+    }
+
+    // binary encodings only when named, the highest q wins and on a tie the more
+    // compact encoding. json is the answer to anything else, even a refused json
+    static const std::pair<const char *, response_encoding> encodings[] = {
+            {"application/msgpack",     response_encoding::msgpack},
+            {"application/x-msgpack",   response_encoding::msgpack},
+            {"application/cbor",        response_encoding::cbor},
+            {"application/x-qpdb-wire", response_encoding::wire},
+    };
+    response_encoding encoding = response_encoding::json;
+    double best = get_media_quality(accept, "application/json", true);
+    for (const auto &[type, candidate]: encodings) {
+        double quality = get_media_quality(accept, type, false);
+        if (quality > 0 && quality >= best && (encoding == response_encoding::json || quality > best)) {
+            encoding = candidate;
+            best = quality;
+        }
+    }
+    return encoding;
+}
+
+const char *get_content_type(response_encoding encoding) {
+    switch (encoding) {
+        case response_encoding::msgpack:
+            return "application/msgpack";
+        case response_encoding::cbor:
+            return "application/cbor";
+        case response_encoding::wire:
+            return "application/x-qpdb-wire";
+        default:
+            return "application/json";
+    }
+}
+
+void set_body(const httplib::Request &req, httplib::Response &res,
+              const std::string &body, const char *content_type) {
+    res.set_header("Vary", "Accept, Accept-Encoding");
+
+    std::string compressed;
+    content_coding coding = negotiate_coding(req, body.size());
+    if (coding != content_coding::identity && compress_body(body, coding, compressed)) {
+        res.set_header("Content-Encoding", get_coding_name(coding));
+        res.set_content(compressed, content_type);
+        return;
+    }
+    res.set_content(body, content_type);
+}
+
+// not every result has a fixed layout, those stay json when wire is asked for
+static response_encoding get_structured_encoding(const httplib::Request &req) {
+    response_encoding encoding = negotiate_encoding(req);
+    return encoding == response_encoding::wire ? response_encoding::json : encoding;
+}
+
+void write_symbol_wire(std::string &body, const pdb_request &request, const symbol_result &result) {
+    // the names are '\0' terminated (a name_buffer or a shared memory slot) as the hash expects
+    begin_wire(body, qpdb_wire::symbol, request.symbols.size());
+    for (std::string_view name: request.symbols) {
+        int64_t offset = result[request.query.symbols.index(name)];
+        append_wire(body, qpdb_wire::hash(name.data()), offset, 0);
+    }
+}
+
+void write_struct_wire(std::string &body, const pdb_request &request, const struct_result &result) {
+    begin_wire(body, qpdb_wire::structure, request.structs.members.size());
+    for (const auto &[type, name]: request.structs.members) {
+        const field_info &field = result.fields[get_member_index(request.query.structs, type, name)];
+        append_wire(body, qpdb_wire::hash(type.data(), name.data()), field.offset, field.bitfield_offset);
+    }
+}
+
+void write_enum_wire(std::string &body, const pdb_request &request, const enum_result &result) {
+    begin_wire(body, qpdb_wire::enumeration, request.enums.members.size());
+    for (const auto &[type, name]: request.enums.members) {
+        int64_t value = result.values[get_member_index(request.query.enums, type, name)];
+        append_wire(body, qpdb_wire::hash(type.data(), name.data()), value, 0);
+    }
+}
+
+void set_symbol_result(const httplib::Request &req, httplib::Response &res,
+                       const pdb_request &request, const symbol_result &result) {
+    std::string &body = get_output_buffer();
+    response_encoding encoding = negotiate_encoding(req);
+    if (encoding == response_encoding::wire) {
+        write_symbol_wire(body, request, result);
+    } else {
+        response_writer writer(body, get_writer_format(encoding));
+        write_symbols(writer, request.query.symbols, result);
+    }
+    set_body(req, res, body, get_content_type(encoding));
+}
+
+void set_struct_result(const httplib::Request &req, httplib::Response &res,
+                       const pdb_request &request, const struct_result &result) {
+    std::string &body = get_output_buffer();
+    response_encoding encoding = negotiate_encoding(req);
+    if (encoding == response_encoding::wire) {
+        write_struct_wire(body, request, result);
+    } else {
+        response_writer writer(body, get_writer_format(encoding));
+        write_structs(writer, request.query.structs, result);
+    }
+    set_body(req, res, body, get_content_type(encoding));
+}
+
+void set_enum_result(const httplib::Request &req, httplib::Response &res,
+                     const pdb_request &request, const enum_result &result) {
+    std::string &body = get_output_buffer();
+    response_encoding encoding = negotiate_encoding(req);
+    if (encoding == response_encoding::wire) {
+        write_enum_wire(body, request, result);
+    } else {
+        response_writer writer(body, get_writer_format(encoding));
+        write_enums(writer, request.query.enums, result);
+    }
+    set_body(req, res, body, get_content_type(encoding));
+}
+
+void set_query_result(const httplib::Request &req, httplib::Response &res,
+                      const pdb_request &request, const pdb_query_result &result) {
+    std::string &body = get_output_buffer();
+    response_encoding encoding = get_structured_encoding(req);
+    response_writer writer(body, get_writer_format(encoding));
+    write_query(writer, request, result);
+    set_body(req, res, body, get_content_type(encoding));
+}
+
+void set_batch_result(const httplib::Request &req, httplib::Response &res,
+                      const std::pmr::vector<pdb_request> &requests,
+                      const std::vector<std::optional<pdb_query_result>> &results,
+                      const std::vector<std::string> &errors) {
+    std::string &body = get_output_buffer();
+    response_encoding encoding = get_structured_encoding(req);
+    response_writer writer(body, get_writer_format(encoding));
+    writer.begin_array(requests.size());
+    for (size_t i = 0; i < requests.size(); i++) {
+        if (!results[i]) {
+            writer.begin_object(1);
+            writer.key("error");
+            writer.value(errors[i]);
+            writer.end_object();
+        } else {
+            write_query(writer, requests[i], *results[i]);
+        }
+    }
+    writer.end_array();
+    set_body(req, res, body, get_content_type(encoding));
+}
@@ -0,0 +1,58 @@
+#ifndef QUERY_PDB_SERVER_RESPONSE_ENCODING_H
+#define QUERY_PDB_SERVER_RESPONSE_ENCODING_H
+
+#include <memory_resource>
+#include <optional>
+#include <string>
+#include <vector>
+#include <httplib.h>
+#include "pdb_parser.h"
+#include "request_reader.h"
+
+// body encodings a client can ask for with the Accept header,
+// all of them carry the same data model
+enum class response_encoding {
+    json,
+    msgpack,
+    cbor,
+    // fixed layout binary records (see client/qpdb_wire.h)
+    wire,
+};
+
+response_encoding negotiate_encoding(const httplib::Request &req);
+
+const char *get_content_type(response_encoding encoding);
+
+// set the response body, compressed if it is large enough and the client accepts it
+void set_body(const httplib::Request &req, httplib::Response &res,
+              const std::string &body, const char *content_type);
+
+// append the wire encoding of a result to body (see client/qpdb_wire.h)
+void write_symbol_wire(std::string &body, const pdb_request &request, const symbol_result &result);
+
+void write_struct_wire(std::string &body, const pdb_request &request, const struct_result &result);
+
+void write_enum_wire(std::string &body, const pdb_request &request, const enum_result &result);
+
+// write a result in the negotiated encoding straight into the response body, the wire
+// encoding has one record per requested name in request order (see client/qpdb_wire.h)
+void set_symbol_result(const httplib::Request &req, httplib::Response &res,
+                       const pdb_request &request, const symbol_result &result);
+
+void set_struct_result(const httplib::Request &req, httplib::Response &res,
+                       const pdb_request &request, const struct_result &result);
+
+void set_enum_result(const httplib::Request &req, httplib::Response &res,
+                     const pdb_request &request, const enum_result &result);
+
+// /query and /batch results have no fixed layout, they are json if wire is asked for
+void set_query_result(const httplib::Request &req, httplib::Response &res,
+                      const pdb_request &request, const pdb_query_result &result);
+
+// a batch entry with an error gets {"error": "..."} instead of its result
+void set_batch_result(const httplib::Request &req, httplib::Response &res,
+                      const std::pmr::vector<pdb_request> &requests,
+                      const std::vector<std::optional<pdb_query_result>> &results,
+                      const std::vector<std::string> &errors);
+
+#endif //QUERY_PDB_SERVER_RESPONSE_ENCODING_H
@@ -0,0 +1,232 @@
+#include <charconv>
+#include <limits>
+#include "response_writer.h"
+
+response_writer::response_writer(std::string &buffer, format f)
+        : buffer_(buffer),
+          format_(f),
+          separate_(false) {}
+
+void response_writer::begin_object(size_t size) {
+    switch (format_) {
+        case format::msgpack:
+            write_msgpack_head(0x80, 15, 0xde, size);
+            break;
+        case format::cbor:
+            write_cbor_head(5, size);
+            break;
+        default:
+            separate();
+            buffer_ += '{';
+            separate_ = false;
+            break;
+    }
+}
+
+void response_writer::end_object() {
+    if (format_ == format::json) {
+        buffer_ += '}';
+        separate_ = true;
+    }
+}
+
+void response_writer::begin_array(size_t size) {
+    switch (format_) {
+        case format::msgpack:
+            write_msgpack_head(0x90, 15, 0xdc, size);
+            break;
+        case format::cbor:
+            write_cbor_head(4, size);
+            break;
+        default:
+            separate();
+            buffer_ += '[';
+            separate_ = false;
+            break;
+    }
+}
+
+void response_writer::end_array() {
+    if (format_ == format::json) {
+        buffer_ += ']';
+        separate_ = true;
+    }
+}
+
+void response_writer::key(std::string_view name) {
+    write_string(name);
+    if (format_ == format::json) {
+        buffer_ += ':';
+        separate_ = false;
+    }
+}
+
+void response_writer::value(int64_t number) {
+    switch (format_) {
+        case format::msgpack:
+            if (number >= 0) {
+                auto n = static_cast<uint64_t>(number);
+                if (n < 128) {
+                    buffer_ += static_cast<char>(n);
+                } else if (n <= std::numeric_limits<uint8_t>::max()) {
+                    buffer_ += static_cast<char>(0xcc);
+                    write_big_endian(n, 1);
+                } else if (n <= std::numeric_limits<uint16_t>::max()) {
+                    buffer_ += static_cast<char>(0xcd);
+                    write_big_endian(n, 2);
+                } else if (n <= std::numeric_limits<uint32_t>::max()) {
+                    buffer_ += static_cast<char>(0xce);
+                    write_big_endian(n, 4);
+                } else {
+                    buffer_ += static_cast<char>(0xcf);
+                    write_big_endian(n, 8);
+                }
+            } else {
+                auto n = static_cast<uint64_t>(number);
+                if (number >= -32) {
+                    buffer_ += static_cast<char>(number);
+                } else if (number >= std::numeric_limits<int8_t>::min()) {
+                    buffer_ += static_cast<char>(0xd0);
+                    write_big_endian(n, 1);
+                } else if (number >= std::numeric_limits<int16_t>::min()) {
+                    buffer_ += static_cast<char>(0xd1);
+                    write_big_endian(n, 2);
+                } else if (number >= std::numeric_limits<int32_t>::min()) {
+                    buffer_ += static_cast<char>(0xd2);
+                    write_big_endian(n, 4);
+                } else {
+                    buffer_ += static_cast<char>(0xd3);
+                    write_big_endian(n, 8);
+                }
+            }
+            break;
+        case format::cbor:
+            if (number >= 0) {
+                write_cbor_head(0, static_cast<uint64_t>(number));
+            } else {
+                write_cbor_head(1, static_cast<uint64_t>(-1 - number));
+            }
+            break;
+        default: {
+            separate();
+            char text[24];
+            auto result = std::to_chars(std::begin(text), std::end(text), number);
+            buffer_.append(text, result.ptr);
+            separate_ = true;
+            break;
+        }
+    }
+}
+
+void response_writer::value(std::string_view text) {
+    write_string(text);
+    separate_ = true;
+}
+
+void response_writer::separate() {
+    if (separate_) {
+        buffer_ += ',';
+    }
+}
+
+void response_writer::write_string(std::string_view text) {
+    switch (format_) {
+        case format::msgpack:
+            if (text.size() <= 31) {
+                buffer_ += static_cast<char>(0xa0 | text.size());
+            } else if (text.size() <= std::numeric_limits<uint8_t>::max()) {
+                buffer_ += static_cast<char>(0xd9);
+                write_big_endian(text.size(), 1);
+            } else if (text.size() <= std::numeric_limits<uint16_t>::max()) {
+                buffer_ += static_cast<char>(0xda);
+                write_big_endian(text.size(), 2);
+            } else {
+                buffer_ += static_cast<char>(0xdb);
+                write_big_endian(text.size(), 4);
+            }
+            buffer_ += text;
+            break;
+        case format::cbor:
+            write_cbor_head(3, text.size());
+            buffer_ += text;
+            break;
+        default:
+            separate();
+            buffer_ += '"';
+            for (char c: text) {
+                switch (c) {
+                    case '"':
+                        buffer_ += "\\\"";
+                        break;
+                    case '\\':
+                        buffer_ += "\\\\";
+                        break;
+                    case '\b':
+                        buffer_ += "\\b";
+                        break;
+                    case '\f':
+                        buffer_ += "\\f";
+                        break;
+                    case '\n':
+                        buffer_ += "\\n";
+                        break;
+                    case '\r':
+                        buffer_ += "\\r";
+                        break;
+                    case '\t':
+                        buffer_ += "\\t";
+                        break;
+                    default:
+                        if (static_cast<unsigned char>(c) < 0x20) {
+                            const char *hex = "0123456789abcdef";
+                            buffer_ += "\\u00";
+                            buffer_ += hex[(c >> 4) & 0xf];
+                            buffer_ += hex[c & 0xf];
+                        } else {
+                            buffer_ += c;
+                        }
+                        break;
+                }
+            }
+            buffer_ += '"';
+            break;
+    }
+}
+
+void response_writer::write_big_endian(uint64_t number, size_t size) {
+    for (size_t i = size; i > 0; i--) {
+        buffer_ += static_cast<char>((number >> ((i - 1) * 8)) & 0xff);
+    }
+}
+
+void response_writer::write_msgpack_head(uint8_t fix, size_t fix_max, uint8_t head16, size_t size) {
+    if (size <= fix_max) {
+        buffer_ += static_cast<char>(fix | size);
+    } else if (size <= std::numeric_limits<uint16_t>::max()) {
+        buffer_ += static_cast<char>(head16);
+        write_big_endian(size, 2);
+    } else {
+        // the 32 bit head follows the 16 bit one (0xdc/0xdd, 0xde/0xdf)
+        buffer_ += static_cast<char>(head16 + 1);
+        write_big_endian(size, 4);
+    }
+}
+
+void response_writer::write_cbor_head(uint8_t major, uint64_t number) {
+    auto type = static_cast<uint8_t>(major << 5);
+    if (number <= 0x17) {
+        buffer_ += static_cast<char>(type | number);
+    } else if (number <= std::numeric_limits<uint8_t>::max()) {
+        buffer_ += static_cast<char>(type | 24);
+        write_big_endian(number, 1);
+    } else if (number <= std::numeric_limits<uint16_t>::max()) {
+        buffer_ += static_cast<char>(type | 25);
+        write_big_endian(number, 2);
+    } else if (number <= std::numeric_limits<uint32_t>::max()) {
+        buffer_ += static_cast<char>(type | 26);
+        write_big_endian(number, 4);
+    } else {
+        buffer_ += static_cast<char>(type | 27);
+        write_big_endian(number, 8);
+    }
+}
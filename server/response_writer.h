@@ -0,0 +1,53 @@
+#ifndef QUERY_PDB_SERVER_RESPONSE_WRITER_H
+#define QUERY_PDB_SERVER_RESPONSE_WRITER_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// writes json, msgpack or cbor straight into a buffer without building a json value.
+// the bytes are those nlohmann::json produces for the same data, as long as the caller
+// writes object keys sorted (nlohmann::json keeps objects in a std::map).
+// msgpack and cbor put the size of a container in front of it, so it has to be known
+class response_writer {
+public:
+    enum class format {
+        json,
+        msgpack,
+        cbor,
+    };
+
+    response_writer(std::string &buffer, format f);
+
+    void begin_object(size_t size);
+
+    void end_object();
+
+    void begin_array(size_t size);
+
+    void end_array();
+
+    void key(std::string_view name);
+
+    void value(int64_t number);
+
+    void value(std::string_view text);
+
+private:
+    std::string &buffer_;
+    format format_;
+    // json: a value was written at this level, the next one needs a ','
+    bool separate_;
+
+    void separate();
+
+    void write_string(std::string_view text);
+
+    void write_big_endian(uint64_t number, size_t size);
+
+    void write_msgpack_head(uint8_t fix, size_t fix_max, uint8_t head16, size_t size);
+
+    void write_cbor_head(uint8_t major, uint64_t number);
+};
+
+#endif //QUERY_PDB_SERVER_RESPONSE_WRITER_H
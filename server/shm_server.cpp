@@ -0,0 +1,435 @@
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <spdlog/spdlog.h>
+#ifdef __linux__
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+#include "request_arena.h"
+#include "response_encoding.h"
+#include "shm_server.h"
+
+static_assert(sizeof(qpdb_shm::ring_header) == 64 && sizeof(qpdb_shm::slot_header) == 64);
+
+// without requests for this long the thread stops spinning and sleeps, with a single
+// cpu it sleeps right away, spinning would only keep the clients from running
+static std::chrono::microseconds get_spin_time() {
+    return std::chrono::microseconds(std::thread::hardware_concurrency() > 1 ? 100 : 0);
+}
+
+// how often the slots are checked for clients that ended while holding one
+static constexpr std::chrono::seconds reclaim_interval(1);
+
+// owner of a slot being reclaimed, never a process id
+static constexpr uint32_t reclaiming = 0xffffffff;
+
+// decode the request of a slot. a client may still write to the slot, whether by
+// mistake or on purpose, so the data is copied to the arena of the request first and
+// the names are views into the copy, sorting them sees names that do not change
+static bool read_slot(qpdb_shm::slot_header *slot, pdb_request &request) {
+    uint16_t kind = slot->kind;
+    uint32_t count = slot->count;
+    uint32_t size = slot->size;
+    if (size > qpdb_shm::data_capacity ||
+        (kind != qpdb_wire::symbol && kind != qpdb_wire::structure && kind != qpdb_wire::enumeration)) {
+        return false;
+    }
+
+    auto data = static_cast<char *>(request.memory->allocate(size, 1));
+    memcpy(data, qpdb_shm::get_data(slot), size);
+    const char *position = data;
+    const char *end = position + size;
+    auto next = [&position, end](std::string_view &text) {
+        auto terminator = static_cast<const char *>(memchr(position, 0, end - position));
+        if (!terminator) {
+            return false;
+        }
+        text = std::string_view(position, terminator - position);
+        position = terminator + 1;
+        return true;
+    };
+
+    std::string_view name;
+    if (!next(name) || name.empty()) {
+        return false;
+    }
+    request.name = name;
+    request.guid.assign(slot->guid, strnlen(slot->guid, sizeof(slot->guid)));
+    request.age = slot->age;
+
+    type_list &types = kind == qpdb_wire::structure ? request.structs : request.enums;
+    for (uint32_t i = 0; i < count; i++) {
+        std::string_view symbol;
+        std::string_view type;
+        std::string_view member;
+        if (kind == qpdb_wire::symbol) {
+            if (!next(symbol)) {
+                return false;
+            }
+            request.symbols.push_back(symbol);
+        } else {
+            if (!next(type) || !next(member)) {
+                return false;
+            }
+            if (types.types.empty() || types.types.back() != type) {
+                types.types.push_back(type);
+            }
+            types.members.emplace_back(type, member);
+        }
+    }
+    request.has_symbols = kind == qpdb_wire::symbol;
+    request.has_structs = kind == qpdb_wire::structure;
+    request.has_enums = kind == qpdb_wire::enumeration;
+    index_request(request);
+    return true;
+}
+
+// the response cache key of a slot request, apart from the keys of the http requests.
+// the records follow the request order, so do the names in the key
+static std::string get_response_key(const pdb_request &request) {
+    std::string key = request.has_symbols ? "shm symbol\n" : request.has_structs ? "shm struct\n" : "shm enum\n";
+    std::string guid = request.guid;
+    std::transform(guid.begin(), guid.end(), guid.begin(), toupper);
+    key += request.name + "\n" + guid + "\n" + std::to_string(request.age) + "\n";
+    if (request.has_symbols) {
+        for (std::string_view name: request.symbols) {
+            key += name;
+            key += '\0';
+        }
+        return key;
+    }
+    for (const auto &[type, member]: (request.has_structs ? request.structs : request.enums).members) {
+        key += type;
+        key += '\0';
+        key += member;
+        key += '\0';
+    }
+    return key;
+}
+
+shm_server::shm_server(downloader &storage, pdb_cache &parsers, response_cache &responses,
+                       admission_control &admission, work_pool &cpu_pool, work_pool &io_pool)
+        : storage_(storage),
+          parsers_(parsers),
+          responses_(responses),
+          admission_(admission),
+          cpu_pool_(cpu_pool),
+          io_pool_(io_pool),
+          ring_(nullptr),
+          size_(0),
+          stopping_(false) {}
+
+shm_server::~shm_server() {
+    stop();
+#ifdef __linux__
+    if (ring_) {
+        munmap(ring_, size_);
+    }
+#endif
+}
+
+bool shm_server::is_supported() {
+#ifdef __linux__
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool shm_server::start(const std::string &path, uint32_t slot_count) {
+#ifdef __linux__
+    // clients still attached to the ring of a previous run keep their own copy
+    std::error_code ec;
+    std::filesystem::remove(path, ec);
+    int fd = open(path.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0660);
+    if (fd == -1) {
+        spdlog::error("failed to create shm ring, path: {}", path);
+        return false;
+    }
+    size_t size = qpdb_shm::ring_size(slot_count);
+    void *ring = MAP_FAILED;
+    if (ftruncate(fd, static_cast<off_t>(size)) == 0) {
+        ring = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    if (ring == MAP_FAILED) {
+        spdlog::error("failed to map shm ring, path: {}", path);
+        std::filesystem::remove(path, ec);
+        return false;
+    }
+    ring_ = ring;
+    size_ = size;
+    path_ = path;
+
+    // the file is zero filled, every slot is idle. the magic goes last, a client
+    // mapping the ring before takes it as invalid
+    auto header = static_cast<qpdb_shm::ring_header *>(ring_);
+    header->version = qpdb_shm::version;
+    header->slot_count = slot_count;
+    header->slot_size = qpdb_shm::slot_size;
+    header->server_pid = getpid();
+    header->pid_namespace = qpdb_shm::get_pid_namespace();
+    qpdb_shm::store(&header->magic, qpdb_shm::magic);
+
+    thread_ = std::thread(&shm_server::run, this);
+    spdlog::info("serve shm ring, path: {}, slots: {}", path, slot_count);
+    return true;
+#else
+    (void) path;
+    (void) slot_count;
+    return false;
+#endif
+}
+
+void shm_server::stop() {
+#ifdef __linux__
+    if (!thread_.joinable()) {
+        return;
+    }
+    stopping_ = true;
+    auto header = static_cast<qpdb_shm::ring_header *>(ring_);
+    __atomic_fetch_add(&header->doorbell, 1, __ATOMIC_SEQ_CST);
+    qpdb_shm::wake(&header->doorbell);
+    thread_.join();
+    std::error_code ec;
+    std::filesystem::remove(path_, ec);
+#endif
+}
+
+void shm_server::run() {
+#ifdef __linux__
+    auto header = static_cast<qpdb_shm::ring_header *>(ring_);
+    auto spin_time = get_spin_time();
+    auto last_request = std::chrono::steady_clock::now();
+    auto last_reclaim = last_request;
+    while (!stopping_) {
+        if (std::chrono::steady_clock::now() - last_reclaim >= reclaim_interval) {
+            reclaim();
+            last_reclaim = std::chrono::steady_clock::now();
+        }
+        if (poll()) {
+            last_request = std::chrono::steady_clock::now();
+            continue;
+        }
+        if (std::chrono::steady_clock::now() - last_request < spin_time) {
+            qpdb_shm::pause();
+            continue;
+        }
+
+        // a client rings the doorbell after submitting and wakes the thread if it
+        // sleeps. slots submitted before the flag was set are found by the last poll
+        uint32_t doorbell = qpdb_shm::load(&header->doorbell);
+        qpdb_shm::store(&header->server_sleeping, 1);
+        if (!poll() && !stopping_) {
+            qpdb_shm::wait(&header->doorbell, doorbell, 100 * 1000 * 1000);
+        }
+        qpdb_shm::store(&header->server_sleeping, 0);
+        last_request = std::chrono::steady_clock::now();
+    }
+#endif
+}
+
+bool shm_server::poll() {
+#ifdef __linux__
+    auto header = static_cast<qpdb_shm::ring_header *>(ring_);
+    bool found = false;
+    for (uint32_t i = 0; i < header->slot_count; i++) {
+        qpdb_shm::slot_header *slot = qpdb_shm::get_slot(ring_, i);
+        if (qpdb_shm::load(&slot->state) == qpdb_shm::submitted &&
+            qpdb_shm::exchange(&slot->state, qpdb_shm::submitted, qpdb_shm::working)) {
+            handle(slot);
+            found = true;
+        }
+    }
+    return found;
+#else
+    return false;
+#endif
+}
+
+void shm_server::reclaim() {
+#ifdef __linux__
+    auto header = static_cast<qpdb_shm::ring_header *>(ring_);
+    for (uint32_t i = 0; i < header->slot_count; i++) {
+        qpdb_shm::slot_header *slot = qpdb_shm::get_slot(ring_, i);
+        // the owner is a pid of the namespace of the server, a client of another
+        // namespace cannot map the ring (see qpdb_shm::client)
+        uint32_t owner = qpdb_shm::load(&slot->owner);
+        if (owner == 0 || owner == reclaiming || kill(static_cast<pid_t>(owner), 0) == 0 || errno != ESRCH) {
+            continue;
+        }
+        // the owner word keeps acquiring clients away meanwhile, the ended owner
+        // changes nothing anymore, only the server moves a submitted slot on
+        if (!qpdb_shm::exchange(&slot->owner, owner, reclaiming)) {
+            continue;
+        }
+        uint32_t state = qpdb_shm::load(&slot->state);
+        if (state == qpdb_shm::submitted || state == qpdb_shm::working) {
+            // taken back once it is answered
+            qpdb_shm::store(&slot->owner, owner);
+            continue;
+        }
+        qpdb_shm::store(&slot->client_waiting, 0);
+        qpdb_shm::store(&slot->state, qpdb_shm::idle);
+        qpdb_shm::store(&slot->owner, 0);
+        spdlog::warn("reclaim shm slot of ended client, slot: {}, pid: {}", i, owner);
+    }
+#endif
+}
+
+void shm_server::handle(qpdb_shm::slot_header *slot) {
+    try {
+        request_arena arena;
+        pdb_request request(&arena);
+        if (!read_slot(slot, request)) {
+            finish(slot, qpdb_shm::invalid);
+            return;
+        }
+
+        // the hot path, a response kept from an earlier request is answered on this
+        // thread. anything that scans the pdb goes to the pools, a large struct or enum
+        // query holds up none of the other slots
+        if (auto response = responses_.find(get_response_key(request))) {
+            reply(slot, response->body);
+            return;
+        }
+        pdb_location location;
+        bool present = storage_.find(request.name, request.guid, request.age, location);
+        answer_later(slot, present, location);
+    } catch (std::exception &e) {
+        spdlog::error("shm request failed, error: {}", e.what());
+        finish(slot, qpdb_shm::failed);
+    }
+}
+
+void shm_server::answer_later(qpdb_shm::slot_header *slot, bool present, const pdb_location &location) {
+    // admitted like an http request, the slots are held until the work is done
+    using shared_slot = std::shared_ptr<admission_control::slot>;
+    shared_slot request_slot;
+    shared_slot download_slot;
+    shared_slot parse_slot;
+    try {
+        request_slot = std::make_shared<admission_control::slot>(
+                admission_.admit(admission_control::work::request));
+        if (!present) {
+            download_slot = std::make_shared<admission_control::slot>(
+                    admission_.admit(admission_control::work::download));
+        }
+        if (!present || !parsers_.find(location)) {
+            parse_slot = std::make_shared<admission_control::slot>(
+                    admission_.admit(admission_control::work::parse));
+        }
+    } catch (overloaded_error &e) {
+        finish(slot, qpdb_shm::overloaded);
+        return;
+    }
+
+    // the pool tasks decode the slot again into their own arena
+    auto parse = [this, slot, request_slot, parse_slot](const pdb_location &location) {
+        cpu_pool_.submit([this, slot, request_slot, parse_slot, location]() {
+            try {
+                request_arena arena;
+                pdb_request request(&arena);
+                if (!read_slot(slot, request)) {
+                    finish(slot, qpdb_shm::invalid);
+                    return;
+                }
+                auto parser = get_parser(request, location);
+                answer(slot, *parser, request);
+            } catch (std::exception &e) {
+                spdlog::error("shm request failed, error: {}", e.what());
+                finish(slot, qpdb_shm::failed);
+            }
+        });
+    };
+    if (present) {
+        parse(location);
+        return;
+    }
+
+    io_pool_.submit([this, slot, download_slot, parse]() mutable {
+        pdb_location downloaded;
+        try {
+            request_arena arena;
+            pdb_request request(&arena);
+            if (!read_slot(slot, request)) {
+                finish(slot, qpdb_shm::invalid);
+                return;
+            }
+            if (!storage_.download(request.name, request.guid, request.age, downloaded)) {
+                finish(slot, qpdb_shm::not_found);
+                return;
+            }
+        } catch (std::exception &e) {
+            spdlog::error("shm download failed, error: {}", e.what());
+            finish(slot, qpdb_shm::failed);
+            return;
+        }
+        download_slot.reset();
+        parse(downloaded);
+    });
+}
+
+pdb_cache::pin shm_server::get_parser(const pdb_request &request, pdb_location location) {
+    try {
+        return parsers_.get(location);
+    } catch (std::exception &e) {
+        if (!storage_.recover(request.name, request.guid, request.age, location)) {
+            throw;
+        }
+    }
+    return parsers_.get(location);
+}
+
+void shm_server::answer(qpdb_shm::slot_header *slot, const pdb_parser &parser, const pdb_request &request) {
+    std::string body;
+    if (request.has_symbols) {
+        write_symbol_wire(body, request, parser.get_symbols(request.query.symbols, request.memory));
+    } else if (request.has_structs) {
+        write_struct_wire(body, request, parser.get_struct(request.query.structs, request.memory));
+    } else {
+        write_enum_wire(body, request, parser.get_enum(request.query.enums, request.memory));
+    }
+
+    // kept like an http response, the next identical request is answered by the thread
+    httplib::Response res;
+    res.status = 200;
+    res.set_content(body, get_content_type(response_encoding::wire));
+    auto response = std::make_shared<const stored_response>(res);
+    responses_.insert(get_response_key(request), response);
+    reply(slot, response->body);
+}
+
+void shm_server::reply(qpdb_shm::slot_header *slot, const std::string &body) {
+    // a response too large for the slot leaves nothing half written
+    if (body.size() > qpdb_shm::data_capacity) {
+        finish(slot, qpdb_shm::too_large);
+        return;
+    }
+    memcpy(qpdb_shm::get_data(slot), body.data(), body.size());
+    slot->size = static_cast<uint32_t>(body.size());
+    finish(slot, qpdb_shm::ok);
+}
+
+void shm_server::finish(qpdb_shm::slot_header *slot, qpdb_shm::status status) {
+#ifdef __linux__
+    if (status != qpdb_shm::ok) {
+        slot->size = 0;
+    }
+    slot->status = status;
+    qpdb_shm::store(&slot->state, qpdb_shm::answered);
+    if (qpdb_shm::load(&slot->client_waiting)) {
+        qpdb_shm::wake(&slot->state);
+    }
+#else
+    (void) slot;
+    (void) status;
+#endif
+}
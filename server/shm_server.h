@@ -0,0 +1,81 @@
+#ifndef QUERY_PDB_SERVER_SHM_SERVER_H
+#define QUERY_PDB_SERVER_SHM_SERVER_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <qpdb_shm.h>
+#include "admission_control.h"
+#include "downloader.h"
+#include "pdb_cache.h"
+#include "request_reader.h"
+#include "response_cache.h"
+#include "work_pool.h"
+
+// answers the shared memory ring of client/qpdb_shm.h (linux only). one thread polls
+// the slots and answers requests it finds in the response cache itself. every other
+// request is handed to the pools (downloaded, parsed and scanned there) and answered
+// from there, meanwhile the thread goes on with other slots. the thread spins while
+// requests keep coming and sleeps on a futex when they stop
+class shm_server {
+public:
+    shm_server(downloader &storage, pdb_cache &parsers, response_cache &responses,
+               admission_control &admission, work_pool &cpu_pool, work_pool &io_pool);
+
+    // unmaps the ring, the pools must not run its tasks anymore
+    ~shm_server();
+
+    shm_server(const shm_server &) = delete;
+
+    shm_server &operator=(const shm_server &) = delete;
+
+    static bool is_supported();
+
+    // create the ring with slot_count slots at path (a file on tmpfs, replaced if it
+    // exists) and start answering, false if the ring cannot be created
+    bool start(const std::string &path, uint32_t slot_count);
+
+    // stop the thread and remove the ring file, requests still on the pools are
+    // answered into the mapped ring
+    void stop();
+
+private:
+    downloader &storage_;
+    pdb_cache &parsers_;
+    response_cache &responses_;
+    admission_control &admission_;
+    work_pool &cpu_pool_;
+    work_pool &io_pool_;
+    void *ring_;
+    size_t size_;
+    std::string path_;
+    std::thread thread_;
+    std::atomic<bool> stopping_;
+
+    void run();
+
+    // answer every submitted slot, false if there was none
+    bool poll();
+
+    // free the slots of clients that ended without releasing them, the clients share
+    // the pid namespace of the server
+    void reclaim();
+
+    void handle(qpdb_shm::slot_header *slot);
+
+    // download, parse and query the pdb on the pools, then answer
+    void answer_later(qpdb_shm::slot_header *slot, bool present, const pdb_location &location);
+
+    // parses the pdb, a file that changed in the download path is found or downloaded again
+    pdb_cache::pin get_parser(const pdb_request &request, pdb_location location);
+
+    // query the parser and keep the response in the cache
+    void answer(qpdb_shm::slot_header *slot, const pdb_parser &parser, const pdb_request &request);
+
+    static void reply(qpdb_shm::slot_header *slot, const std::string &body);
+
+    static void finish(qpdb_shm::slot_header *slot, qpdb_shm::status status);
+};
+
+#endif //QUERY_PDB_SERVER_SHM_SERVER_H
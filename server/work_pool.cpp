@@ -0,0 +1,143 @@
+#include <algorithm>
+#include <spdlog/spdlog.h>
+#include "work_pool.h"
+
+thread_local work_pool *work_pool::current_pool_ = nullptr;
+thread_local size_t work_pool::current_worker_ = 0;
+
+work_pool::work_pool(size_t threads)
+        : pending_{0, 0, 0},
+          next_(0),
+          running_prefetch_(0),
+          stopping_(false) {
+    threads = std::max<size_t>(1, threads);
+    max_prefetch_ = std::max<size_t>(1, threads - 1);
+    for (size_t i = 0; i < threads; i++) {
+        workers_.push_back(std::make_unique<worker>());
+    }
+    for (size_t i = 0; i < threads; i++) {
+        threads_.emplace_back(&work_pool::work, this, i);
+    }
+}
+
+work_pool::~work_pool() {
+    shutdown();
+}
+
+void work_pool::submit(std::function<void()> task, work_priority priority) {
+    auto p = static_cast<size_t>(priority);
+    // a worker queues follow-up work on its own deque, others spread it round robin
+    size_t index = current_pool_ == this ? current_worker_ : next_++ % workers_.size();
+    {
+        // counted under the lock, a worker about to sleep sees it. counted before it is
+        // queued, a worker taking it right away never sees the count below zero
+        std::lock_guard lock(mutex_);
+        pending_[p]++;
+        std::lock_guard worker_lock(workers_[index]->mutex);
+        workers_[index]->tasks[p].push_back(std::move(task));
+    }
+    available_.notify_one();
+}
+
+void work_pool::shutdown() {
+    {
+        std::lock_guard lock(mutex_);
+        stopping_ = true;
+    }
+    available_.notify_all();
+    for (auto &thread: threads_) {
+        if (thread.joinable()) {
+            thread.join();
+        }
+    }
+}
+
+void work_pool::work(size_t index) {
+    current_pool_ = this;
+    current_worker_ = index;
+
+    std::function<void()> task;
+    work_priority priority;
+    while (take(index, task, priority)) {
+        try {
+            task();
+        } catch (std::exception &e) {
+            spdlog::error("task failed, error: {}", e.what());
+        } catch (...) {
+            spdlog::error("task failed, unknown exception");
+        }
+        task = nullptr;
+
+        if (priority == work_priority::prefetch) {
+            {
+                std::lock_guard lock(mutex_);
+                running_prefetch_--;
+            }
+            available_.notify_one();
+        }
+    }
+}
+
+bool work_pool::take(size_t index, std::function<void()> &task, work_priority &priority) {
+    while (true) {
+        for (size_t p = 0; p < priority_count; p++) {
+            bool prefetch = p == static_cast<size_t>(work_priority::prefetch);
+            if (prefetch) {
+                // reserve the worker before taking, the last one stays free
+                std::lock_guard lock(mutex_);
+                if (running_prefetch_ >= max_prefetch_) {
+                    break;
+                }
+                running_prefetch_++;
+            }
+            if (take_queued(index, p, task)) {
+                priority = static_cast<work_priority>(p);
+                return true;
+            }
+            if (prefetch) {
+                std::lock_guard lock(mutex_);
+                running_prefetch_--;
+            }
+        }
+
+        std::unique_lock lock(mutex_);
+        available_.wait(lock, [this]() {
+            return is_available() || (stopping_ && pending_[0] + pending_[1] + pending_[2] == 0);
+        });
+        if (!is_available()) {
+            return false;
+        }
+    }
+}
+
+bool work_pool::take_queued(size_t index, size_t priority, std::function<void()> &task) {
+    // own tasks in the order they were queued
+    {
+        auto &own = workers_[index]->tasks[priority];
+        std::lock_guard lock(workers_[index]->mutex);
+        if (!own.empty()) {
+            task = std::move(own.front());
+            own.pop_front();
+            pending_[priority]--;
+            return true;
+        }
+    }
+
+    // steal the newest task of another worker, its owner works on the oldest
+    for (size_t i = 1; i < workers_.size(); i++) {
+        auto &victim = *workers_[(index + i) % workers_.size()];
+        std::lock_guard lock(victim.mutex);
+        if (!victim.tasks[priority].empty()) {
+            task = std::move(victim.tasks[priority].back());
+            victim.tasks[priority].pop_back();
+            pending_[priority]--;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool work_pool::is_available() const {
+    return pending_[0] > 0 || pending_[1] > 0 ||
+           (pending_[2] > 0 && running_prefetch_ < max_prefetch_);
+}
@@ -0,0 +1,95 @@
+#ifndef QUERY_PDB_SERVER_WORK_POOL_H
+#define QUERY_PDB_SERVER_WORK_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// how urgent a task is, a worker always takes the most urgent task queued anywhere
+enum class work_priority {
+    // queries an agent is waiting for
+    interactive,
+    // bulk queries like /batch
+    batch,
+    // prefetching and warming nobody waits for yet
+    prefetch,
+};
+
+// fixed set of worker threads, each with its own deques of tasks (one per priority).
+// a worker takes its own tasks oldest first and steals from the other end of another
+// worker's deque when it runs dry, so a few long tasks do not hold up the queued ones.
+// prefetch tasks never occupy the last worker, interactive work always finds one soon.
+// the server keeps one pool for parsing and one for downloads, each sized for its work
+class work_pool {
+public:
+    explicit work_pool(size_t threads);
+
+    ~work_pool();
+
+    work_pool(const work_pool &) = delete;
+
+    work_pool &operator=(const work_pool &) = delete;
+
+    // queue task, exceptions escaping it are logged
+    void submit(std::function<void()> task, work_priority priority = work_priority::interactive);
+
+    // run f on a worker and wait for its result, exceptions are rethrown here.
+    // called from a worker of this pool, f runs right away instead of waiting
+    // for another worker (all of them could be waiting the same way)
+    template<typename F>
+    auto run(F f, work_priority priority = work_priority::interactive) -> decltype(f()) {
+        if (current_pool_ == this) {
+            return f();
+        }
+
+        // shared with the worker, which may still be inside the task when get() returns
+        auto task = std::make_shared<std::packaged_task<decltype(f())()>>(std::move(f));
+        auto result = task->get_future();
+        submit([task]() { (*task)(); }, priority);
+        return result.get();
+    }
+
+    // run the queued tasks and stop the workers
+    void shutdown();
+
+private:
+    static constexpr size_t priority_count = 3;
+
+    struct worker {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks[priority_count];
+    };
+
+    std::vector<std::unique_ptr<worker>> workers_;
+    std::vector<std::thread> threads_;
+    // tasks queued on any worker per priority, idle workers sleep until there is one
+    std::atomic<size_t> pending_[priority_count];
+    std::atomic<size_t> next_;
+    std::mutex mutex_;
+    std::condition_variable available_;
+    // prefetch tasks running and how many may run at once, guarded by mutex_
+    size_t running_prefetch_;
+    size_t max_prefetch_;
+    bool stopping_;
+
+    // the pool and worker the calling thread belongs to, if any
+    static thread_local work_pool *current_pool_;
+    static thread_local size_t current_worker_;
+
+    void work(size_t index);
+
+    bool take(size_t index, std::function<void()> &task, work_priority &priority);
+
+    bool take_queued(size_t index, size_t priority, std::function<void()> &task);
+
+    // there is a task a worker may take now, called with mutex_ held
+    bool is_available() const;
+};
+
+#endif //QUERY_PDB_SERVER_WORK_POOL_H
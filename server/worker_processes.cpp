@@ -0,0 +1,100 @@
+#include <chrono>
+#include <map>
+#include <thread>
+#include <spdlog/spdlog.h>
+#ifdef __linux__
+#include <csignal>
+#include <sys/prctl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+#include "worker_processes.h"
+
+#ifdef __linux__
+// start a worker, returns true in the worker
+static bool start_worker(size_t index, const sigset_t &worker_signals, std::map<pid_t, size_t> &workers) {
+    pid_t pid = fork();
+    if (pid == 0) {
+        sigprocmask(SIG_SETMASK, &worker_signals, nullptr);
+        // a worker does not outlive the parent
+        prctl(PR_SET_PDEATHSIG, SIGTERM);
+        return true;
+    }
+    if (pid == -1) {
+        spdlog::error("failed to start worker, index: {}", index);
+        return false;
+    }
+    workers[pid] = index;
+    spdlog::info("start worker, index: {}, pid: {}", index, pid);
+    return false;
+}
+#endif
+
+bool fork_workers(size_t count, int &exit_code) {
+#ifdef __linux__
+    // the parent takes the signals it waits for synchronously, none of them gets lost
+    // between two waits. workers get the signal mask back
+    sigset_t signals;
+    sigset_t worker_signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGCHLD);
+    sigaddset(&signals, SIGTERM);
+    sigaddset(&signals, SIGINT);
+    sigprocmask(SIG_BLOCK, &signals, &worker_signals);
+
+    std::map<pid_t, size_t> workers;
+    for (size_t i = 0; i < count; i++) {
+        if (start_worker(i, worker_signals, workers)) {
+            return true;
+        }
+    }
+
+    exit_code = 0;
+    bool stopping = false;
+    while (!workers.empty()) {
+        int signal = sigwaitinfo(&signals, nullptr);
+        if (signal == SIGTERM || signal == SIGINT) {
+            if (!stopping) {
+                spdlog::info("stop workers, signal: {}", signal);
+                stopping = true;
+                for (const auto &[pid, index]: workers) {
+                    kill(pid, SIGTERM);
+                }
+            }
+            continue;
+        }
+        if (signal != SIGCHLD) {
+            continue;
+        }
+
+        int status = 0;
+        pid_t pid;
+        while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+            auto it = workers.find(pid);
+            if (it == workers.end()) {
+                continue;
+            }
+            size_t index = it->second;
+            workers.erase(it);
+
+            if (WIFSIGNALED(status) && !stopping) {
+                spdlog::error("worker crashed, index: {}, pid: {}, signal: {}", index, pid, WTERMSIG(status));
+                // a pdb that crashes every worker must not make the parent spin
+                std::this_thread::sleep_for(std::chrono::seconds(1));
+                if (start_worker(index, worker_signals, workers)) {
+                    return true;
+                }
+            } else if (WIFEXITED(status) && WEXITSTATUS(status) != 0) {
+                spdlog::error("worker failed, index: {}, pid: {}, exit code: {}",
+                              index, pid, WEXITSTATUS(status));
+                exit_code = WEXITSTATUS(status);
+            }
+        }
+    }
+    return false;
+#else
+    (void) count;
+    exit_code = 0;
+    return true;
+#endif
+}
@@ -0,0 +1,13 @@
+#ifndef QUERY_PDB_SERVER_WORKER_PROCESSES_H
+#define QUERY_PDB_SERVER_WORKER_PROCESSES_H
+
+#include <cstddef>
+
+// fork count worker processes (linux only). returns true in every worker, which
+// goes on to serve on its own SO_REUSEPORT socket. the parent stays behind and
+// returns false with exit_code once all workers have exited: it restarts a worker
+// that crashes (e.g. on a malformed pdb) and passes SIGTERM and SIGINT on.
+// must be called before any thread is started, elsewhere it returns true at once
+bool fork_workers(size_t count, int &exit_code);
+
+#endif //QUERY_PDB_SERVER_WORKER_PROCESSES_H
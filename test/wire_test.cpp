@@ -0,0 +1,172 @@
+// encodes results with the server's write_*_wire functions and reads them back
+// with the client decoder (client/qpdb_wire.h)
+
+#include <cstddef>
+#include <cstdio>
+#include <string>
+#include <qpdb_wire.h>
+#include "request_reader.h"
+#include "response_encoding.h"
+
+static int failures = 0;
+
+static void check(bool condition, const char *what, int line) {
+    if (!condition) {
+        std::fprintf(stderr, "wire_test.cpp:%d: %s\n", line, what);
+        failures++;
+    }
+}
+
+#define CHECK(condition) check((condition), #condition, __LINE__)
+
+static const char *const pdb = R"("name":"a.pdb","guid":"8F0F3D677778391600F4EB2301FFC7A5","age":1)";
+
+static std::string make_body(const std::string &query) {
+    return std::string("{") + pdb + R"(,"query":)" + query + "}";
+}
+
+// records come in request order, not in the sorted order of the parser
+static void test_symbols() {
+    std::pmr::monotonic_buffer_resource memory;
+    pdb_request request = read_request(make_body(R"(["b","a","missing"])"), query_part::symbols, &memory);
+
+    symbol_result result(request.query.symbols.size(), -1, &memory);
+    result[request.query.symbols.index("a")] = 0x1000;
+    result[request.query.symbols.index("b")] = 0x2000;
+
+    std::string body;
+    write_symbol_wire(body, request, result);
+    CHECK(body.size() == sizeof(qpdb_wire::header) + 3 * sizeof(qpdb_wire::record));
+
+    qpdb_wire::view view(body.data(), body.size());
+    CHECK(view.valid());
+    CHECK(view.kind() == qpdb_wire::symbol);
+    CHECK(view.count() == 3);
+    CHECK(view.at(0).name_hash == qpdb_wire::hash("b"));
+    CHECK(view.at(0).offset == 0x2000);
+    CHECK(view.at(1).name_hash == qpdb_wire::hash("a"));
+    CHECK(view.at(1).offset == 0x1000);
+
+    qpdb_wire::record record{};
+    CHECK(view.find(qpdb_wire::hash("missing"), record));
+    CHECK(record.offset == -1);
+    CHECK(!view.find(qpdb_wire::hash("c"), record));
+}
+
+static void test_structs() {
+    std::pmr::monotonic_buffer_resource memory;
+    pdb_request request = read_request(make_body(R"({"s":["y","x"],"t":["missing"],"u":[]})"),
+                                       query_part::structs, &memory);
+
+    struct_result result(request.query.structs, &memory);
+    auto set_field = [&](std::string_view type, std::string_view member, int64_t offset, int64_t bitfield_offset) {
+        const member_set::entry *entry = request.query.structs.find(type);
+        field_info &field = result.fields[entry->first + entry->members.index(member)];
+        field.offset = offset;
+        field.bitfield_offset = bitfield_offset;
+    };
+    set_field("s", "x", 0, 0);
+    set_field("s", "y", 8, 3);
+
+    std::string body;
+    write_struct_wire(body, request, result);
+
+    // a type without members has no record
+    qpdb_wire::view view(body.data(), body.size());
+    CHECK(view.valid());
+    CHECK(view.kind() == qpdb_wire::structure);
+    CHECK(view.count() == 3);
+    CHECK(view.at(0).name_hash == qpdb_wire::hash("s", "y"));
+    CHECK(view.at(0).offset == 8);
+    CHECK(view.at(0).bitfield_offset == 3);
+    CHECK(view.at(1).name_hash == qpdb_wire::hash("s", "x"));
+    CHECK(view.at(1).offset == 0);
+    CHECK(view.at(1).bitfield_offset == 0);
+    CHECK(view.at(2).name_hash == qpdb_wire::hash("t", "missing"));
+    CHECK(view.at(2).offset == -1);
+    CHECK(view.at(2).bitfield_offset == 0);
+}
+
+static void test_enums() {
+    std::pmr::monotonic_buffer_resource memory;
+    pdb_request request = read_request(make_body(R"({"e":["b","a"]})"), query_part::enums, &memory);
+
+    enum_result result(request.query.enums, &memory);
+    const member_set::entry *entry = request.query.enums.find("e");
+    result.values[entry->first + entry->members.index("a")] = 7;
+
+    std::string body;
+    write_enum_wire(body, request, result);
+
+    qpdb_wire::view view(body.data(), body.size());
+    CHECK(view.valid());
+    CHECK(view.kind() == qpdb_wire::enumeration);
+    CHECK(view.count() == 2);
+    CHECK(view.at(0).name_hash == qpdb_wire::hash("e", "b"));
+    CHECK(view.at(0).offset == -1);
+    CHECK(view.at(1).name_hash == qpdb_wire::hash("e", "a"));
+    CHECK(view.at(1).offset == 7);
+}
+
+static void test_empty() {
+    std::pmr::monotonic_buffer_resource memory;
+    pdb_request request = read_request(make_body("[]"), query_part::symbols, &memory);
+    symbol_result result(&memory);
+
+    std::string body;
+    write_symbol_wire(body, request, result);
+    CHECK(body.size() == sizeof(qpdb_wire::header));
+
+    qpdb_wire::view view(body.data(), body.size());
+    CHECK(view.valid());
+    CHECK(view.count() == 0);
+    qpdb_wire::record record{};
+    CHECK(!view.find(qpdb_wire::hash("a"), record));
+}
+
+static void test_invalid() {
+    std::pmr::monotonic_buffer_resource memory;
+    pdb_request request = read_request(make_body(R"(["a","b"])"), query_part::symbols, &memory);
+    symbol_result result(request.query.symbols.size(), -1, &memory);
+
+    std::string body;
+    write_symbol_wire(body, request, result);
+
+    // a record cut short, a header cut short, nothing at all
+    qpdb_wire::view truncated(body.data(), body.size() - 1);
+    CHECK(!truncated.valid());
+    CHECK(truncated.count() == 0);
+    qpdb_wire::record record{};
+    CHECK(!truncated.find(qpdb_wire::hash("a"), record));
+    CHECK(!qpdb_wire::view(body.data(), sizeof(qpdb_wire::header) - 1).valid());
+    CHECK(!qpdb_wire::view(nullptr, 0).valid());
+
+    // an unaligned copy decodes the same
+    std::string shifted = " " + body;
+    qpdb_wire::view unaligned(shifted.data() + 1, body.size());
+    CHECK(unaligned.valid());
+    CHECK(unaligned.count() == 2);
+    CHECK(unaligned.at(1).name_hash == qpdb_wire::hash("b"));
+
+    std::string wrong_magic = body;
+    wrong_magic[0] ^= 1;
+    CHECK(!qpdb_wire::view(wrong_magic.data(), wrong_magic.size()).valid());
+
+    std::string wrong_version = body;
+    wrong_version[offsetof(qpdb_wire::header, version)] ^= 1;
+    CHECK(!qpdb_wire::view(wrong_version.data(), wrong_version.size()).valid());
+}
+
+int main() {
+    test_symbols();
+    test_structs();
+    test_enums();
+    test_empty();
+    test_invalid();
+
+    if (failures) {
+        std::fprintf(stderr, "%d checks failed\n", failures);
+        return 1;
+    }
+    return 0;
+}